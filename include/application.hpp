@@ -48,4 +48,6 @@ class Application: public Gtk::Application {
         Window* window = nullptr;
         // storage for image option argument
         std::string image_path = "";
+        // storage for trace option argument
+        std::string trace_path = "";
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "image_proc.hpp"
+#include "edit_lut.hpp"
+
+
+namespace batch_processing {
+    /**
+     * Result of a batch run.
+    */
+    struct Summary {
+        size_t processed = 0ul;
+        size_t failed    = 0ul;
+        double seconds   = 0.0;
+
+        inline double imagesPerSecond() const {return this->seconds > 0.0 ? this->processed / this->seconds : 0.0;}
+    };
+
+    /**
+     * Expand the given inputs into a list of image files.
+     * Directories are searched (non recursively) for files with a known image extension,
+     * everything else is taken as a file path as is.
+     *
+     * @param inputs: directories and/or file paths
+     * @return sorted list of image file paths
+    */
+    std::vector<std::string> collectInputs(
+        const std::vector<std::string>& inputs
+    );
+
+    /**
+     * Find a file name shared by several inputs. Results are named like their inputs,
+     * so those inputs would overwrite each other's result in the output directory.
+     *
+     * @param filepaths: input image paths
+     * @return the first shared file name or an empty string if all are distinct
+    */
+    std::string findDuplicateFilename(
+        const std::vector<std::string>& filepaths
+    );
+
+    class BatchProcessor {
+        public:
+            /**
+             * Set up a processor that applies the same edit to every image.
+             * The edit is compiled into a 3D lookup table once, every image then takes a single table pass.
+             * The table works on BGR directly, so images go from cv::imread to cv::imwrite without any conversion.
+             *
+             * @param parameters: the edit to be applied
+             * @param output_directory: directory the results get written to (same file names as the inputs)
+             * @param nr_workers: size of the worker pool, 0 for one worker per hardware thread
+             * @param lattice_size: samples per axis of the lookup table (see image_proc::EditLut)
+             * @param encoder_settings: encoder speed/size settings for the results
+            */
+            BatchProcessor(
+                const image_proc::EditParameters& parameters,
+                const std::string& output_directory,
+                size_t nr_workers = 0ul,
+                size_t lattice_size = image_proc::EditLut::FULL_LATTICE,
+                const image_proc::EncoderSettings& encoder_settings = image_proc::EncoderSettings()
+            );
+
+            /**
+             * Process all images with a bounded pool of workers, one image per worker at a time.
+             * Every worker decodes, processes and encodes its own image, so decoding, processing
+             * and encoding of different images overlap.
+             *
+             * @param filepaths: images to be processed
+             * @return summary of the run
+            */
+            Summary run(const std::vector<std::string>& filepaths);
+        private:
+            /**
+             * Worker loop: take the next unprocessed image until none are left.
+             *
+             * (internal)
+            */
+            void work();
+
+            /**
+             * Load, edit and save a single image.
+             *
+             * (internal)
+             *
+             * @param filepath: path to the input image
+             * @return wether or not the image was processed and saved
+            */
+            bool processImage(const std::string& filepath) const;
+
+
+            const image_proc::EditLut edit_lut;
+            const image_proc::EncoderSettings encoder_settings;
+            const std::string output_directory;
+            const size_t nr_workers;
+
+            // state of the current run
+            const std::vector<std::string>* filepaths = nullptr;
+            std::atomic<size_t> next_index {0ul},
+                                processed  {0ul},
+                                failed     {0ul};
+            mutable std::mutex log_mutex;
+    };
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "macros.hpp"
+#include "color_spaces.hpp"
+
+
+namespace image_proc {
+    /**
+     * Keeps the source image converted into the LIMIT color spaces, so changing the limits never converts again.
+     * Conversions for other color spaces can be started in the background; the converted images of
+     * spaces not in use are evicted (least recently used first) once they exceed the memory budget.
+     * The space in use is the one last requested through get, background conversions never change it.
+     * All methods are thread safe.
+    */
+    class ConversionCache {
+        public:
+            /**
+             * Start the background conversion thread.
+             *
+             * @param memory_budget: bytes the converted images of inactive color spaces may use
+            */
+            ConversionCache(size_t memory_budget = CONVERSION_CACHE_BUDGET);
+
+            /**
+             * Stop and join the background conversion thread.
+            */
+            ~ConversionCache();
+
+            /**
+             * Set a new source image, invalidating all converted images.
+             *
+             * @param source: source image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+            */
+            void setSource(const cv::Mat& source);
+
+            /**
+             * Return an image converted into a color space, converting it first if needed.
+             * Blocks while a background conversion of that color space is still running.
+             * Images other than the current source get converted without being cached.
+             * For the current source, the color space becomes the one in use, which is never evicted.
+             *
+             * @param source: the image to be converted, usually the current source
+             * @param color_space: the wanted color space
+             * @return converted image (the source itself for RGB)
+            */
+            cv::Mat get(const cv::Mat& source, const ColorSpace& color_space);
+
+            /**
+             * Return an image converted into a color space only if it is available right away, never converting or
+             * waiting. Like get, the color space becomes the one in use.
+             *
+             * @param source: the image to be converted, usually the current source
+             * @param color_space: the wanted color space
+             * @return converted image (the source itself for RGB), empty if it is not cached
+            */
+            cv::Mat tryGet(const cv::Mat& source, const ColorSpace& color_space);
+
+            /**
+             * Start converting the source into a color space in the background.
+             *
+             * @param color_space: the color space that will be needed soon
+            */
+            void prefetch(const ColorSpace& color_space);
+        private:
+            /**
+             * Background thread loop: convert the queued color spaces.
+             *
+             * (internal)
+            */
+            void work();
+
+            /**
+             * Store a finished conversion and evict old ones if the budget is exceeded.
+             * Expects mutex to be locked.
+             *
+             * (internal)
+             *
+             * @param color_space: color space of the converted image
+             * @param converted: the converted image
+            */
+            void store(const ColorSpace& color_space, const cv::Mat& converted);
+
+
+            const size_t memory_budget;
+
+            std::mutex mutex;
+            std::condition_variable condition;
+
+            cv::Mat  source;
+            uint64_t source_version = 0u,
+                     use_counter    = 0u;
+
+            std::array<cv::Mat,  ColorSpace::LAST> converted;
+            std::array<uint64_t, ColorSpace::LAST> last_used {};
+            std::array<bool,     ColorSpace::LAST> converting {};
+            // last requested through get, RGB for none (RGB is never stored)
+            ColorSpace active = ColorSpace::RGB;
+
+            std::deque<ColorSpace> prefetch_queue;
+            bool stopping = false;
+
+            std::thread thread;
+    };
+}
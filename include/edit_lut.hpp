@@ -0,0 +1,65 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "image_proc.hpp"
+
+
+namespace image_proc {
+    /**
+     * A complete edit (LIMIT or Channels, followed by compression) compiled into a 3D lookup table over RGB.
+     * Every edit is a pure function of the input pixel, so the table is built by running applyEdits once over
+     * all (lattice) colors; compiling therefore does not depend on the size of the images it is applied to.
+     * With the full lattice of 256 values per axis the table is exact (64MB), smaller lattices (a few KB to MB)
+     * are interpolated trilinearly and only approximate edges of LIMIT masks and compression steps.
+    */
+    class EditLut {
+        public:
+            static constexpr size_t FULL_LATTICE = 256ul;
+
+            /**
+             * Compile an edit.
+             *
+             * @param parameters: the edit to be compiled
+             * @param lattice_size: samples per axis, from 2 to FULL_LATTICE (exact)
+             * @param bgr: apply to BGR images (as read and written by cv::imread/cv::imwrite) instead of RGB ones
+            */
+            EditLut(const EditParameters& parameters, size_t lattice_size = FULL_LATTICE, bool bgr = false);
+
+            /**
+             * Apply the compiled edit to an image. Can be used in place (src and dst being the same image).
+             *
+             * @param src: source image in RGB (BGR if compiled for BGR)
+             * @param dst: output image in the same channel order (will be overwritten)
+            */
+            void apply(const cv::Mat& src, cv::Mat& dst) const;
+
+            /**
+             * Return the number of samples per axis.
+             *
+             * @return lattice size
+            */
+            inline size_t getLatticeSize() const {return this->lattice_size;}
+        private:
+            /**
+             * Apply one row through the lattice with trilinear interpolation.
+             *
+             * (internal)
+             *
+             * @param src: input row in RGB
+             * @param dst: output row (may be the same as src)
+             * @param width: number of pixels in the row
+            */
+            void interpolateRow(const uint8_t* src, uint8_t* dst, size_t width) const;
+
+
+            const size_t lattice_size;
+
+            // full lattice: packed pixels as expected by kernels::lookup3DRow
+            std::vector<uint32_t> table;
+            // smaller lattices: pixel triples, index ((c0 * size) + c1) * size + c2
+            std::vector<uint8_t>  lattice;
+    };
+}
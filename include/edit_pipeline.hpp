@@ -0,0 +1,207 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <functional>
+
+#include "image_proc.hpp"
+#include "conversion_cache.hpp"
+#include "limit_index.hpp"
+#include "palette.hpp"
+#include "scratch_arena.hpp"
+
+
+namespace image_proc {
+    /**
+     * The render path as a graph of cached stages:
+     * source -> color conversion (LIMIT only) -> edit (mask and composite) -> compression -> statistics.
+     * Every stage keeps its output together with the parameters and the upstream version it was computed from,
+     * and only runs again when one of those changed. LIMIT and Channels each have their own branch below the source,
+     * so switching between them with unchanged parameters reuses both results, and a new compression level only
+     * runs compression and statistics.
+     * Incremental pipelines (full resolution) edit few-colored images per palette color and LIMIT edits through
+     * a LimitIndex. Not thread safe, a pipeline belongs to a single render thread.
+    */
+    class EditPipeline {
+        public:
+            /**
+             * Create an empty pipeline, the first render runs every stage.
+             *
+             * @param conversion_cache: cache to take LIMIT color space conversions of the source from
+             * @param scratch_arena: arena the stage outputs are taken from
+             * @param incremental: use the palette and the limit index (worth it for full resolution sources)
+            */
+            EditPipeline(ConversionCache* conversion_cache, ScratchArena* scratch_arena, bool incremental);
+
+            /**
+             * Render an edit, running only the stages whose inputs changed.
+             *
+             * @param source: source image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+             * @param parameters: the edit to be applied
+             * @param image: output of the last stage (will be overwritten), shared with the cache and must not be modified
+             * @param statistics: statistics of image (will be overwritten)
+            */
+            void render(const cv::Mat& source, const EditParameters& parameters, cv::Mat& image, ImageStatistics& statistics);
+
+            /**
+             * Check wether a render would only run cheap stages: the pipeline holds the source and either edits it per
+             * palette color, already holds the edit (only compression and statistics left) or can update its limit index.
+             *
+             * @param source: source image in RGB
+             * @param parameters: the edit to be applied
+             * @return wether or not the edit stage is cached or incremental
+            */
+            bool isWarm(const cv::Mat& source, const EditParameters& parameters) const;
+
+            /**
+             * Prepare what makes the following edits of a source incremental, without rendering the edit itself:
+             * the palette and, for LIMIT, the color conversion and the limit index. Channels edits of sources without
+             * a palette get nothing more, their edit stage has to go over every pixel anyway.
+             *
+             * @param source: source image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+             * @param parameters: the edit to be prepared for
+             * @param cancelled: polled between the stages, preparing stops once it returns true
+            */
+            void warmUp(const cv::Mat& source, const EditParameters& parameters, const std::function<bool()>& cancelled);
+
+            /**
+             * Return the number of stages the last render had to run, 0 if everything was cached.
+             *
+             * @return number of stages run
+            */
+            inline size_t getStagesRun() const {return this->nr_stages_run;}
+        private:
+            /**
+             * Bookkeeping of a stage: what its cached output was computed from.
+            */
+            template<typename Key>
+            struct Stage {
+                bool     valid          = false;
+                Key      key            {};
+                uint64_t input_version  = 0u;
+                // changes with every run, so the downstream stages notice
+                uint64_t version        = 0u;
+
+                inline bool isCurrent(const Key& key, uint64_t input_version) const {
+                    return this->valid && this->key == key && this->input_version == input_version;
+                }
+            };
+
+            // LIMIT: the bounds as applied, Channels: modifier and channel
+            typedef std::array<int, 2 * NR_CHANNELS> EditKey;
+
+            /**
+             * The stages below the source that belong to one edit mode.
+            */
+            struct Branch {
+                Stage<EditKey>  edit_stage;
+                cv::Mat         edited;
+                // edited is the limit index output, which changes with its next update
+                bool            edited_volatile = false;
+                ImageStatistics edited_statistics;
+
+                Stage<double>   compression_stage;
+                // per color: the compressed palette colors the output got gathered from
+                cv::Mat         compressed_colors;
+                cv::Mat         output;
+
+                Stage<double>   statistics_stage;
+                ImageStatistics statistics;
+            };
+
+            /**
+             * Record a run of a stage.
+             *
+             * (internal)
+             *
+             * @param stage: the stage that ran
+             * @param key: parameters it ran with
+             * @param input_version: upstream version it ran on
+            */
+            template<typename Key>
+            void ran(Stage<Key>& stage, const Key& key, uint64_t input_version) {
+                stage.valid         = true;
+                stage.key           = key;
+                stage.input_version = input_version;
+                stage.version       = ++this->version_counter;
+                this->nr_stages_run++;
+            }
+
+            /**
+             * Take over a new source, dropping everything computed from the old one.
+             *
+             * (internal)
+             *
+             * @param source: source image in RGB
+            */
+            void setSource(const cv::Mat& source);
+
+            /**
+             * Run the color conversion stage unless it is current.
+             *
+             * (internal)
+             *
+             * @param color_space: LIMIT color space
+            */
+            void convert(ColorSpace color_space);
+
+            /**
+             * Return the key of the edit stage.
+             *
+             * (internal)
+             *
+             * @param parameters: the edit to be applied
+             * @return LIMIT: the bounds as applied, Channels: modifier and channel
+            */
+            static EditKey getEditKey(const EditParameters& parameters);
+
+            /**
+             * Run the edit stage: LIMIT mask and composite or the channel manipulation, without compression.
+             *
+             * (internal)
+             *
+             * @param branch: branch of the edit mode
+             * @param parameters: the edit to be applied
+             * @param pixels: source image or palette colors
+             * @param converted: pixels converted into the LIMIT color space
+            */
+            void edit(Branch& branch, const EditParameters& parameters, const cv::Mat& pixels, const cv::Mat& converted);
+
+            /**
+             * Run the compression stage, for palettes the colors get gathered into the image afterwards.
+             *
+             * (internal)
+             *
+             * @param branch: branch of the edit mode
+             * @param compression_level: level of compression from 1 bit to 8 bits
+            */
+            void compress(Branch& branch, double compression_level);
+
+            /**
+             * Collect the distinct colors of a new source and log the compaction ratio.
+             *
+             * (internal)
+            */
+            void buildPalette();
+
+
+            ConversionCache* const  conversion_cache;
+            ScratchArena* const     scratch_arena;
+            const bool              incremental;
+
+            uint64_t version_counter = 0u;
+            size_t   nr_stages_run   = 0ul;
+
+            cv::Mat     source;
+            uint64_t    source_version = 0u;
+            Palette     palette;
+
+            Stage<ColorSpace>   conversion_stage;
+            cv::Mat             converted;
+            LimitIndex          limit_index;
+
+            // indexed by EditMode
+            std::array<Branch, 2> branches;
+    };
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <glibmm/dispatcher.h>
+#include <opencv2/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "raw_image_cache.hpp"
+
+
+/**
+ * Decodes images on a dedicated thread so the Gtk main loop never blocks on cv::imread.
+ * Large images are kept decoded in a RawImageCache, so reopening them only maps the cached pixels.
+ * Other JPEG files are first decoded at a reduced resolution (which libjpeg does much faster) to have something
+ * to show, then at full resolution. Starting a new load cancels the running one: its remaining steps are skipped and
+ * its results are dropped (a single cv::imread call itself can not be interrupted).
+ * Results are handed back like the frames of the RenderWorker.
+*/
+class ImageLoader {
+    public:
+        enum Stage {
+            PREVIEW,    // reduced resolution, the full image follows
+            FULL,       // final image
+            FAILED      // the file could not be decoded
+        };
+
+        /**
+         * A step of a load.
+        */
+        struct Result {
+            uint64_t    generation;
+            std::string filepath;
+            Stage       stage;
+            cv::Mat     image;
+        };
+
+        /**
+         * Start the loader thread. Has to be constructed on the thread running the Gtk main loop.
+        */
+        ImageLoader();
+
+        /**
+         * Stop and join the loader thread, waiting for a running decode to finish.
+        */
+        ~ImageLoader();
+
+        /**
+         * Start loading an image, cancelling any load still running.
+         *
+         * @param filepath: path to the image
+         * @return generation number of the load
+        */
+        uint64_t load(const std::string& filepath);
+
+        /**
+         * Take the newest result of the current load. Older results that were never taken are dropped.
+         *
+         * @return the result or nullptr if there is none
+        */
+        std::unique_ptr<Result> takeResult();
+
+        /**
+         * Signal emitted on the main loop when a result is ready to be taken.
+         *
+         * @return the dispatcher to connect to
+        */
+        inline Glib::Dispatcher& signalResultReady() {return this->result_ready;}
+    private:
+        /**
+         * Loader thread loop: wait for the newest request and decode it step by step.
+         *
+         * (internal)
+        */
+        void work();
+
+        /**
+         * Hand a result over to the main loop, unless its load got cancelled in the meantime.
+         *
+         * (internal)
+         *
+         * @param result: the result to be handed over
+         * @return wether or not the load is still current
+        */
+        bool publish(std::unique_ptr<Result> result);
+
+        /**
+         * Check wether a load got replaced by a newer one.
+         *
+         * (internal)
+         *
+         * @param generation: generation of the load
+         * @return wether or not the load got cancelled
+        */
+        bool cancelled(uint64_t generation) const;
+
+
+        // only used by the loader thread
+        image_proc::RawImageCache   raw_cache;
+
+        std::mutex                  request_mutex;
+        std::condition_variable     request_condition;
+        std::string                 pending_filepath;
+        uint64_t                    pending_generation = 0u;
+        bool                        stopping = false;
+        std::atomic<uint64_t>       newest_generation {0u};
+
+        // lock-free handoff of the newest result
+        std::atomic<Result*>        finished_result {nullptr};
+        Glib::Dispatcher            result_ready;
+
+        std::thread                 thread;
+};
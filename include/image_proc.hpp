@@ -3,7 +3,9 @@
 #include <opencv2/opencv.hpp>
 #include <gtkmm/image.h>
 
+#include <array>
 #include <string>
+#include <vector>
 
 #include "macros.hpp"
 #include "color_spaces.hpp"
@@ -45,6 +47,7 @@ namespace image_proc {
 
     /**
      * Change image look by manipulating certain channels.
+     * Can be used in place (src and dst being the same image).
      * 
      * @param src: source image in RGB color space
      * @param dst: output image (will be overwritten)
@@ -61,6 +64,7 @@ namespace image_proc {
 
     /**
      * Compress image (with losses) to lower bits per channel per pixel.
+     * Can be used in place (src and dst being the same image).
      * 
      * @param src: source image
      * @param dst: output image (will be overwritten)
@@ -72,6 +76,123 @@ namespace image_proc {
         double compression_level
     );
 
+    /**
+     * Return the lookup table compressImage uses for a compression level.
+     * Tables are built once per level and cached.
+     * 
+     * @param compression_level: level of compression from 1 bit to 8 bits
+     * @return 1x256 CV_8UC1 table mapping channel values to compressed channel values
+    */
+    const cv::Mat& getCompressionTable(
+        double compression_level
+    );
+
+
+    enum EditMode {
+        LIMIT = 0,
+        CHANNELS = 1
+    };
+
+    /**
+     * Snapshot of every parameter an edit depends on, so it can be reproduced without the GUI.
+    */
+    struct EditParameters {
+        EditMode        mode                = EditMode::LIMIT;
+
+        // LIMIT parameters, pattern: min, max, min, max, min, max
+        ColorSpace      color_space         = ColorSpace::RGB;
+        std::array<double, 2 * NR_CHANNELS> limits {{0.0, 255.0, 0.0, 255.0, 0.0, 255.0}};
+
+        // Channels parameters
+        ModifierOption  modifier            = ModifierOption::AVG;
+        ChannelOption   channel             = ChannelOption::ALL;
+
+        double          compression_level   = 8.0;
+    };
+
+    /**
+     * Encoder settings for saveImage, trading encoding speed against file size. Formats a setting does not apply to ignore it.
+     * Settings left UNSET are not passed to cv::imwrite, so the encoder defaults apply (for PNG that is zlib level 1
+     * with the RLE strategy and the SUB filter, which only gets used while no compression level is given).
+    */
+    struct EncoderSettings {
+        static constexpr int UNSET = -1;
+
+        // zlib level from 0 (fastest) to 9 (smallest)
+        int     png_compression = UNSET;
+        // one of cv::ImwritePNGFlags
+        int     png_strategy    = UNSET;
+        // from 0 to 100
+        int     jpeg_quality    = UNSET;
+        // optimized huffman tables: slightly smaller files, slower encoding
+        bool    jpeg_optimize   = false;
+
+        /**
+         * Return the settings as cv::imwrite parameters.
+         * 
+         * @return list of flag/value pairs
+        */
+        std::vector<int> toImwriteParameters() const;
+    };
+
+    /**
+     * Statistics of an edited image, gathered while the edit writes its output.
+    */
+    struct ImageStatistics {
+        size_t nr_pixels   = 0ul;
+        // LIMIT only: number of pixels within the bounds
+        size_t nr_in_range = 0ul;
+        std::array<std::array<uint64_t, 256>, NR_CHANNELS> histograms {};
+
+        /**
+         * Merge the statistics of another part of the image.
+         * 
+         * @param other: statistics to be added
+        */
+        void add(const ImageStatistics& other);
+
+        /**
+         * Remap the histograms as if the image got compressed afterwards.
+         * 
+         * @param compression_table: table as returned by getCompressionTable
+        */
+        void compress(const cv::Mat& compression_table);
+
+        /**
+         * Return the sum of a channel over all pixels.
+         * 
+         * @param channel: channel index
+         * @return sum of the channel values
+        */
+        uint64_t sum(size_t channel) const;
+
+        /**
+         * Return the mean of a channel.
+         * 
+         * @param channel: channel index
+         * @return mean channel value (0.0 for an empty image)
+        */
+        double mean(size_t channel) const;
+    };
+
+    /**
+     * Apply a complete edit (LIMIT or Channels, followed by compression) to an image.
+     * Editing, compression and statistics happen row by row in a single pass.
+     * 
+     * @param src: source image in RGB
+     * @param dst: output image (will be overwritten)
+     * @param parameters: the edit to be applied
+     * @param converted: src already converted into the LIMIT color space (optional, skips the conversion)
+     * @param statistics: statistics of dst (optional, will be overwritten)
+    */
+    void applyEdits(
+        const cv::Mat& src,
+        cv::Mat& dst,
+        const EditParameters& parameters,
+        const cv::Mat& converted = cv::Mat(),
+        ImageStatistics* statistics = nullptr
+    );
+
 
     /**
      * Load image from a file and converts it to RGB.
@@ -79,11 +200,13 @@ namespace image_proc {
      * 
      * @param image: output image (will be overwritten)
      * @param filepath: path to image file
+     * @param imread_flags: flags passed to cv::imread, e.g. cv::IMREAD_REDUCED_COLOR_4 for a quick preview
      * @return wether or not the load was successfull
     */
     bool loadImage(
         cv::Mat& image,
-        const std::string& filepath
+        const std::string& filepath,
+        int imread_flags = cv::IMREAD_COLOR
     );
 
     /**
@@ -91,11 +214,15 @@ namespace image_proc {
      * 
      * @param image: source image
      * @param filepath: file path to save image to
+     * @param settings: encoder speed/size settings
+     * @param bgr: the image already is in BGR (as cv::imwrite expects), saves the conversion copy
      * @return wether or not the save was successfull
     */
     bool saveImage(
         const cv::Mat& image,
-        const std::string& filepath
+        const std::string& filepath,
+        const EncoderSettings& settings = EncoderSettings(),
+        bool bgr = false
     );
 
 
@@ -110,6 +237,34 @@ namespace image_proc {
         const cv::Mat& image
     );
 
+    /**
+     * Return a representation of the average color from already gathered statistics.
+     * Same format as for an image, without another pass over it.
+     * 
+     * @param statistics: statistics of the image
+     * @return formatted mean string
+    */
+    std::string getAverageColorString(
+        const ImageStatistics& statistics
+    );
+
+
+    /**
+     * Create the gradient shown next to a LIMIT scale: the channel runs from 255 (top row) to 0 (bottom row) while
+     * the other channels stay at a neutral value, converted to RGB for display.
+     * 
+     * @param color_space: color space of the channel
+     * @param channel: channel index within the color space
+     * @param height: height in pixels, e.g. the exact height of the scale
+     * @param width: width in pixels
+     * @return gradient image (RGB, 3 channel, 8bit)
+    */
+    cv::Mat createLimitPreview(
+        const ColorSpace& color_space,
+        size_t channel,
+        int height,
+        int width = STD_PREVIEW_WIDTH
+    );
 
     /**
      * Convert an image from a cv::Mat to an Gtk::Image.
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glibmm/dispatcher.h>
+#include <opencv2/core.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_proc.hpp"
+
+
+/**
+ * Encodes and writes images on a dedicated thread so the Gtk main loop never blocks on cv::imwrite.
+ * Saves are never dropped: they are written one after another in the order they were requested,
+ * and the destructor waits for all of them.
+ * Finished saves are announced on the main loop via a Glib::Dispatcher.
+*/
+class ImageSaver {
+    public:
+        /**
+         * A finished save.
+        */
+        struct Result {
+            std::string filepath;
+            bool        success;
+            double      seconds;
+        };
+
+        /**
+         * Start the saver thread. Has to be constructed on the thread running the Gtk main loop.
+        */
+        ImageSaver();
+
+        /**
+         * Write all queued images, then stop and join the saver thread.
+        */
+        ~ImageSaver();
+
+        /**
+         * Queue an image to be saved.
+         *
+         * @param image: image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+         * @param filepath: file path to save image to
+         * @param settings: encoder speed/size settings
+        */
+        void save(const cv::Mat& image, const std::string& filepath, const image_proc::EncoderSettings& settings);
+
+        /**
+         * Take the results of all saves finished since the last call.
+         *
+         * @return finished saves, oldest first
+        */
+        std::vector<Result> takeResults();
+
+        /**
+         * Return the number of saves queued or running.
+         *
+         * @return number of unfinished saves
+        */
+        size_t getPendingCount() const;
+
+        /**
+         * Signal emitted on the main loop when a save finished.
+         *
+         * @return the dispatcher to connect to
+        */
+        inline Glib::Dispatcher& signalSaveFinished() {return this->save_finished;}
+    private:
+        struct Job {
+            cv::Mat                     image;
+            std::string                 filepath;
+            image_proc::EncoderSettings settings;
+        };
+
+        /**
+         * Saver thread loop: write the queued images one after another.
+         *
+         * (internal)
+        */
+        void work();
+
+
+        mutable std::mutex          mutex;
+        std::condition_variable     condition;
+        std::deque<Job>             jobs;
+        size_t                      nr_running = 0ul;
+        std::vector<Result>         results;
+        bool                        stopping = false;
+
+        Glib::Dispatcher            save_finished;
+
+        std::thread                 thread;
+};
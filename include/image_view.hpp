@@ -0,0 +1,123 @@
+#pragma once
+
+#include <gtkmm/drawingarea.h>
+#include <cairomm/surface.h>
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <vector>
+
+
+/**
+ * Shows an image from pixels it owns: frames are converted once into a persistent Cairo surface in native ARGB32
+ * layout, so the view never points into a cv::Mat that might be released or reused afterwards.
+ * There are two surfaces, one for each image size in use (e.g. the full resolution frame and the preview),
+ * so alternating between previews and full renders does not allocate. A new frame of the same size only converts
+ * and invalidates the rows that differ from the frame the surface holds.
+ * Zoomed out views are drawn from a mipmap pyramid of 2x2 area averages (at most a third of the surface in size),
+ * whose levels are built on first use and afterwards only updated where frames changed.
+ * Parts of a frame (e.g. the visible tiles of a render still in progress) can be shown ahead of the complete frame.
+*/
+class ImageView: public Gtk::DrawingArea {
+    public:
+        /**
+         * Show an image.
+         *
+         * @param image: image in RGB (8bit, 3 channels), must not be modified afterwards (assign a new cv::Mat instead)
+         * @param display_size: size the image gets drawn at without zoom, e.g. the full resolution while showing
+         *                      a preview (default: the image size)
+        */
+        void setImage(const cv::Mat& image, const cv::Size& display_size = cv::Size());
+
+        /**
+         * Show part of an image ahead of the complete image, on the surface of the display size.
+         *
+         * @param image: pixels of the region in RGB (8bit, 3 channels)
+         * @param region: part of the displayed image the pixels belong to
+         * @return wether the region got shown, not the case if there is no surface of the display size yet
+        */
+        bool setRegion(const cv::Mat& image, const cv::Rect& region);
+
+        /**
+         * Change the zoom, the view requests the zoomed display size.
+         *
+         * @param zoom: scale of the display size, 1.0 for 1:1
+        */
+        void setZoom(double zoom);
+
+        /**
+         * Return the current zoom.
+         *
+         * @return scale of the display size
+        */
+        inline double getZoom() const {return this->zoom;}
+    protected:
+        /**
+         * Paint the (damaged part of the) front surface from the nearest pyramid level, scaled to the zoomed display size.
+         *
+         * @param context: cairo context to draw on
+         * @return true, the view is painted completely
+        */
+        bool on_draw(const Cairo::RefPtr<Cairo::Context>& context) override;
+    private:
+        /**
+         * A level of a mipmap pyramid, half the size of the level below.
+        */
+        struct Level {
+            Cairo::RefPtr<Cairo::ImageSurface> surface;
+            // rows that do not match the level below anymore
+            cv::Range dirty_rows;
+        };
+
+        /**
+         * Convert pixels into an area of a surface.
+         *
+         * (internal)
+         *
+         * @param pixels: pixels in RGB, of the size of area
+         * @param surface: surface to be written
+         * @param area: area of the surface to be written
+        */
+        void convert(const cv::Mat& pixels, const Cairo::RefPtr<Cairo::ImageSurface>& surface, const cv::Rect& area);
+
+        /**
+         * Mark rows of a surface as changed, so the pyramid levels get updated and the rows redrawn.
+         *
+         * (internal)
+         *
+         * @param index: index of the surface
+         * @param rows: changed rows
+        */
+        void damage(size_t index, const cv::Range& rows);
+
+        /**
+         * Return a level of the pyramid of a surface, building or updating it (and the levels below) as needed.
+         *
+         * (internal)
+         *
+         * @param index: index of the surface
+         * @param level: wanted level, 0 is the surface itself
+         * @return the level's surface
+        */
+        Cairo::RefPtr<Cairo::ImageSurface> getLevel(size_t index, size_t level);
+
+        /**
+         * Update the size request to the zoomed display size.
+         *
+         * (internal)
+        */
+        void updateSizeRequest();
+
+
+        std::array<Cairo::RefPtr<Cairo::ImageSurface>, 2> surfaces;
+        // the images last converted into the surfaces, to find the rows a new frame changed
+        std::array<cv::Mat, 2> converted_images;
+        // rows regions were written to since, they do not match the converted images anymore
+        std::array<cv::Range, 2> stale_rows;
+        // levels 1 and up of the surfaces
+        std::array<std::vector<Level>, 2> pyramids;
+        size_t front = 0ul;
+
+        cv::Size display_size;
+        double   zoom = 1.0;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "macros.hpp"
+
+
+/**
+ * Row kernels for the hot image_proc paths.
+ * All kernels work on interleaved 8bit 3 channel rows. The kernels in image_proc::kernels dispatch at runtime
+ * to the best implementation the CPU supports, the ISA specific namespaces are only exposed for benchmarking.
+*/
+namespace image_proc::kernels {
+    /**
+     * Composite one row for the LIMIT edit: pixels with all channels within the (inclusive) bounds are copied,
+     * all others are replaced by their gray value (same fixed point weights as cv::COLOR_RGB2GRAY).
+     *
+     * @param src: input row, already converted into the limiting color space
+     * @param dst: output row (may be the same as src)
+     * @param width: number of pixels in the row
+     * @param lower: lower bounds per channel
+     * @param upper: upper bounds per channel
+     * @return number of pixels within the bounds
+    */
+    size_t limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper);
+
+    /**
+     * Value channelsRow computes per pixel.
+    */
+    enum Component {
+        MINIMUM   = 0, AVERAGE    = 1, MAXIMUM   = 2,
+        CHANNEL_0 = 3, CHANNEL_1  = 4, CHANNEL_2 = 5,
+        // computed from RGB, bit exact to the channels of cv::COLOR_RGB2HSV_FULL
+        HUE       = 6, SATURATION = 7, VALUE     = 8,
+        LAST_COMPONENT
+    };
+
+    /**
+     * Composite one row for the Channels edit: one value is computed per pixel and either written into
+     * all channels or into one channel with the other two set to 0.
+     * Every combination has its own specialized kernel, selected through a table.
+     *
+     * @param src: input row in RGB
+     * @param dst: output row (may be the same as src)
+     * @param width: number of pixels in the row
+     * @param component: value to be computed
+     * @param output_channel: channel to write the value to (0, 1 or 2) or -1 for all channels
+    */
+    void channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel);
+
+    /**
+     * One specialized channelsRow kernel, component and output channel are template parameters of the implementation.
+    */
+    typedef void (*ChannelsRowKernel)(const uint8_t* src, uint8_t* dst, size_t width);
+
+    /**
+     * Map every pixel of a row through a full 3D lookup table over RGB.
+     *
+     * @param src: input row in RGB
+     * @param dst: output row (may be the same as src)
+     * @param width: number of pixels in the row
+     * @param table: 2^24 entries indexed by (r << 16) | (g << 8) | b, each holding the output pixel as r | (g << 8) | (b << 16)
+    */
+    void lookup3DRow(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* table);
+
+    /**
+     * Add the values of one row to per channel histograms.
+     * Not dispatched, histogramming is bound by the counter updates.
+     *
+     * @param row: interleaved row
+     * @param width: number of pixels in the row
+     * @param histograms: one histogram of 256 bins per channel, consecutive
+    */
+    void histogramRow(const uint8_t* row, size_t width, uint32_t* histograms);
+
+    /**
+     * Return the name of the instruction set the dispatched kernels use.
+     *
+     * @return "avx2", "sse4.1" or "scalar"
+    */
+    std::string instructionSet();
+
+
+    namespace scalar {
+        size_t limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper);
+        void channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel);
+        void lookup3DRow(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* table);
+    }
+
+#ifdef HAVE_SSE4_KERNELS
+    namespace sse4 {
+        size_t limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper);
+        void channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel);
+    }
+#endif
+
+#ifdef HAVE_AVX2_KERNELS
+    namespace avx2 {
+        size_t limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper);
+        void channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel);
+        void lookup3DRow(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* table);
+    }
+#endif
+}
+
+
+#define CHANNELS_ROW_KERNELS(kernel, component) \
+    {kernel<component, -1>, kernel<component, 0>, kernel<component, 1>, kernel<component, 2>}
+
+/**
+ * Define the channelsRow dispatch table of an instruction set, indexed by component and output channel + 1.
+ *
+ * @param kernel: kernel template taking the component and the output channel (-1 for all channels)
+*/
+#define DEFINE_CHANNELS_ROW_KERNELS(kernel) \
+    constexpr image_proc::kernels::ChannelsRowKernel channels_row_kernels[image_proc::kernels::Component::LAST_COMPONENT][NR_CHANNELS + 1ul] { \
+        CHANNELS_ROW_KERNELS(kernel, 0), CHANNELS_ROW_KERNELS(kernel, 1), CHANNELS_ROW_KERNELS(kernel, 2), \
+        CHANNELS_ROW_KERNELS(kernel, 3), CHANNELS_ROW_KERNELS(kernel, 4), CHANNELS_ROW_KERNELS(kernel, 5), \
+        CHANNELS_ROW_KERNELS(kernel, 6), CHANNELS_ROW_KERNELS(kernel, 7), CHANNELS_ROW_KERNELS(kernel, 8)  \
+    }
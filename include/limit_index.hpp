@@ -0,0 +1,101 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <vector>
+
+#include "macros.hpp"
+#include "image_proc.hpp"
+
+
+namespace image_proc {
+    /**
+     * Incrementally maintained LIMIT composite of one converted image.
+     * Per channel, the pixel offsets are sorted into 256 value buckets (counting sort), so moving a bound from
+     * t to t+n only visits the pixels with a channel value in [t, t+n). For every pixel the number of bound
+     * violations is tracked; only pixels whose violation count changes between zero and non-zero get rewritten
+     * (and moved between the bins of the output histograms).
+     * Memory: 4 bytes per pixel and channel for the buckets plus 1 byte per pixel for the violation counts.
+    */
+    class LimitIndex {
+        public:
+            /**
+             * Check wether the index was built for this converted image.
+             *
+             * @param converted: converted image
+             * @return wether or not update can be used
+            */
+            bool isBuiltFor(const cv::Mat& converted) const;
+
+            /**
+             * Build the index for a converted image and composite it for the given bounds.
+             *
+             * @param converted: image in the limiting color space (8bit, 3 channels, continuous)
+             * @param lower: lower bounds per channel
+             * @param upper: upper bounds per channel
+            */
+            void build(const cv::Mat& converted, const uint8_t* lower, const uint8_t* upper);
+
+            /**
+             * Move the bounds, updating only the pixels whose state can change.
+             * Falls back to compositing everything if that is cheaper.
+             *
+             * @param lower: new lower bounds per channel
+             * @param upper: new upper bounds per channel
+             * @return number of pixels visited
+            */
+            size_t update(const uint8_t* lower, const uint8_t* upper);
+
+            /**
+             * Return the composite for the current bounds. Changes with the next update.
+             *
+             * @return composited image (same as limitImageByChannels would produce)
+            */
+            inline const cv::Mat& getOutput() const {return this->output;}
+
+            /**
+             * Return the number of pixels within the current bounds.
+             *
+             * @return pixel count
+            */
+            inline size_t getInRangeCount() const {return this->nr_in_range;}
+
+            /**
+             * Return the statistics of the composite, kept up to date by every update.
+             *
+             * @return statistics of getOutput()
+            */
+            image_proc::ImageStatistics getStatistics() const;
+        private:
+            /**
+             * Count the violations and composite every pixel from scratch.
+             *
+             * (internal)
+            */
+            void recompute();
+
+            /**
+             * Add or remove one violation for all pixels with channel values in [first, last].
+             *
+             * (internal)
+             *
+             * @param channel: channel whose buckets are visited
+             * @param first: first bucket value
+             * @param last: last bucket value (inclusive)
+             * @param add: wether to add or remove a violation
+            */
+            void updateBuckets(size_t channel, int first, int last, bool add);
+
+
+            cv::Mat converted, output;
+
+            std::array<std::vector<uint32_t>, NR_CHANNELS>   offsets;
+            std::array<std::array<uint32_t, 257>, NR_CHANNELS> bucket_starts;
+            std::vector<uint8_t> violations;
+            std::array<std::array<uint64_t, 256>, NR_CHANNELS> histograms;
+
+            uint8_t lower[NR_CHANNELS], upper[NR_CHANNELS];
+            size_t nr_in_range = 0ul;
+    };
+}
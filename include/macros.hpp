@@ -4,4 +4,49 @@
 //#define NR_COLOR_SPACES 12ul
 
 #define STD_PREVIEW_WIDTH   4
-#define STD_PREVIEW_HEIGHT  300
\ No newline at end of file
+#define STD_PREVIEW_HEIGHT  300
+
+// fixed point weights of cv::COLOR_RGB2GRAY for 8bit images
+#define GRAY_SHIFT      14
+#define GRAY_WEIGHT_R   4899
+#define GRAY_WEIGHT_G   9617
+#define GRAY_WEIGHT_B   1868
+
+// fixed point divisions of cv::COLOR_RGB2HSV_FULL for 8bit images (hue range 256)
+#define HSV_SHIFT       12
+#define HSV_HUE_RANGE   256
+
+// bytes of converted pixels kept in cache per strip (and thread) by LIMIT edits
+#define LIMIT_STRIP_BYTES (1 << 17)
+
+// number of ranges cv::parallel_for_ splits an image into; the default of one range per row (or pixel)
+// would set up per range state (buffers, partial statistics) far too often
+#define PARALLEL_STRIPES (4.0 * cv::getNumThreads())
+
+// scratch buffers: cache line alignment, buffers of at least one huge page get placed on huge pages
+#define SCRATCH_ALIGNMENT   64ul
+#define HUGE_PAGE_SIZE      (2ul * 1024ul * 1024ul)
+
+// JPEG files larger than this get their first paint decoded at 1/8 instead of 1/4 of the resolution
+#define LOAD_PREVIEW_EIGHTH_BYTES (8ul * 1024ul * 1024ul)
+
+// raw image cache: bytes the cache directory may use, images below this many pixels decode fast enough as is
+#define RAW_CACHE_BUDGET        (8ul * 1024ul * 1024ul * 1024ul)
+#define RAW_CACHE_MIN_PIXELS    (16ul * 1000ul * 1000ul)
+
+// bytes the converted images of inactive LIMIT color spaces may keep in memory
+#define CONVERSION_CACHE_BUDGET (1024ul * 1024ul * 1024ul)
+
+// palette compaction: at most 16bit indices and only if every color covers this many pixels on average
+#define PALETTE_MAX_COLORS      65536ul
+#define PALETTE_MIN_COMPACTION  4ul
+
+// tracing: durations per stage the rolling p50/p99 summary is computed over, events kept for the trace file
+#define TRACE_WINDOW        256ul
+#define TRACE_MAX_EVENTS    (1ul << 21)
+
+// tiled rendering: tile edge length, images from this size on render the visible tiles first,
+// bytes of rendered tiles kept for repeated parameters
+#define TILE_SIZE               256
+#define TILED_RENDER_MIN_PIXELS (8ul * 1000ul * 1000ul)
+#define TILE_CACHE_BUDGET       (512ul * 1024ul * 1024ul)
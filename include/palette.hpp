@@ -0,0 +1,79 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+#include "macros.hpp"
+#include "image_proc.hpp"
+
+
+namespace image_proc {
+    /**
+     * The distinct colors of an image plus a map from every pixel to its color.
+     * Every edit is a pure function of the pixel color, so editing the (usually much smaller) palette
+     * and gathering the edited colors through the index map gives the same result as editing every pixel.
+    */
+    class Palette {
+        public:
+            /**
+             * Collect the distinct colors of an image.
+             * Images with too many colors (see PALETTE_MAX_COLORS and PALETTE_MIN_COMPACTION) are not worth
+             * compacting; the palette then stays empty, but is still considered built for the image.
+             *
+             * @param image: image in RGB (8bit, 3 channels)
+             * @return wether or not the image got compacted
+            */
+            bool build(const cv::Mat& image);
+
+            /**
+             * Check wether build was called for this image.
+             *
+             * @param image: image to be checked
+             * @return wether or not the palette (or the decision not to build one) belongs to the image
+            */
+            bool isBuiltFor(const cv::Mat& image) const;
+
+            /**
+             * Produce an image from (edited) palette colors.
+             *
+             * @param colors: 1xN image of colors in palette order, e.g. an edited copy of getColors()
+             * @param dst: output image (will be overwritten)
+            */
+            void apply(const cv::Mat& colors, cv::Mat& dst) const;
+
+            /**
+             * Return the distinct colors in RGB, sorted by value.
+             *
+             * @return 1xN CV_8UC3 image, empty if the image did not get compacted
+            */
+            inline const cv::Mat& getColors() const {return this->colors;}
+
+            /**
+             * Compute the statistics of the image apply would produce, weighting every color by its pixel count.
+             *
+             * @param colors: 1xN image of colors in palette order, as passed to apply
+             * @param statistics: output statistics (will be overwritten)
+             * @param in_range: 1xN mask (CV_8UC1) of the colors within the LIMIT bounds (optional)
+            */
+            void getStatistics(const cv::Mat& colors, ImageStatistics& statistics, const cv::Mat& in_range = cv::Mat()) const;
+
+            /**
+             * Return the number of pixels per distinct color.
+             *
+             * @return compaction ratio, 0.0 if the image did not get compacted
+            */
+            double getCompactionRatio() const;
+
+            /**
+             * Check wether there is a palette to edit.
+             *
+             * @return wether or not the palette is empty
+            */
+            inline bool empty() const {return this->colors.empty();}
+        private:
+            cv::Mat source, colors, indices;
+            // pixels per color
+            std::vector<uint32_t> counts;
+    };
+}
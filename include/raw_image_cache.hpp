@@ -0,0 +1,77 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+
+#include "macros.hpp"
+
+
+namespace image_proc {
+    /**
+     * On-disk cache of decoded RGB images, so reopening a large file costs an mmap instead of a decode.
+     * Entries are keyed by the canonical path, modification time and size of the source file, so changed
+     * files simply miss. An entry is a page sized header followed by the raw pixels; loads map it read-only
+     * straight into a cv::Mat (unmapped when the last reference goes away), so the image must never be
+     * modified in place. The directory is kept below a size limit by evicting the least recently used entries.
+     * All methods are thread safe.
+    */
+    class RawImageCache {
+        public:
+            /**
+             * Set up the cache, creating its directory if needed. Without a usable directory every lookup misses.
+             *
+             * @param directory: cache directory, empty for $XDG_CACHE_HOME (or ~/.cache) /image_manipulator
+             * @param size_limit: bytes the cache directory may use
+            */
+            RawImageCache(const std::string& directory = "", size_t size_limit = RAW_CACHE_BUDGET);
+
+            /**
+             * Map the cached pixels of an image file.
+             *
+             * @param image: output image (read-only mapping, only overwritten on a hit)
+             * @param filepath: path to the source image file
+             * @return wether or not the image was cached
+            */
+            bool load(cv::Mat& image, const std::string& filepath);
+
+            /**
+             * Store the decoded pixels of an image file, evicting old entries if the size limit is exceeded.
+             *
+             * @param image: decoded image in RGB
+             * @param filepath: path to the source image file
+             * @return wether or not the image got stored
+            */
+            bool store(const cv::Mat& image, const std::string& filepath);
+        private:
+            /**
+             * Return the entry file of a source file in its current state.
+             *
+             * (internal)
+             *
+             * @param filepath: path to the source image file
+             * @param canonical: output canonical path of the source
+             * @param source_time: output modification time of the source
+             * @param source_size: output size of the source
+             * @return entry path, empty if the source does not exist
+            */
+            std::filesystem::path entryPath(const std::string& filepath, std::string& canonical, int64_t& source_time, uint64_t& source_size) const;
+
+            /**
+             * Delete the least recently used entries until the directory fits into the size limit.
+             * Expects mutex to be locked.
+             *
+             * (internal)
+            */
+            void evict();
+
+
+            std::filesystem::path directory;
+            const size_t size_limit;
+            bool usable = false;
+
+            std::mutex mutex;
+    };
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <glibmm/dispatcher.h>
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "image_proc.hpp"
+#include "conversion_cache.hpp"
+#include "edit_pipeline.hpp"
+#include "scratch_arena.hpp"
+#include "tile_renderer.hpp"
+
+
+/**
+ * Renders edits on a dedicated thread so the Gtk main loop never blocks on image processing.
+ * Requests are coalesced: while a render is running, only the newest request is kept and older ones are dropped.
+ * Finished frames are handed back through a lock-free slot and announced on the main loop via a Glib::Dispatcher.
+ * Renders go through an EditPipeline per source (full resolution and proxy), so only the stages an edit changed run again.
+ * Previews render from a proxy the worker downscales from the source. A proxy of a new size is only built while no newer
+ * request is waiting, until then previews keep rendering from the old one.
+ * Requests with a viewport that the pipeline could not serve incrementally are rendered tile by tile instead: a frame of
+ * just the visible tiles comes first, followed by the complete frame unless a newer request arrives in between.
+ * Afterwards, until a newer request arrives, the pipeline prepares its palette and limit index, so the following edits
+ * of the image are incremental.
+*/
+class RenderWorker {
+    public:
+        /**
+         * A finished render.
+        */
+        struct Frame {
+            uint64_t    generation;
+            bool        preview;
+            // part of the source the image covers, empty for the complete image
+            cv::Rect    region;
+            // shared with the pipeline cache, must not be modified
+            cv::Mat     image;
+            // statistics of image, gathered while rendering it
+            image_proc::ImageStatistics statistics;
+        };
+
+        /**
+         * Start the worker thread. Has to be constructed on the thread running the Gtk main loop.
+         * 
+         * @param conversion_caches: caches to take LIMIT color space conversions from, one per source
+         *                           (full resolution and proxy); sources not in the caches get converted as usual
+         * @param scratch_arena: arena the stage outputs are taken from, they return to it once released
+        */
+        RenderWorker(const std::array<image_proc::ConversionCache*, 2>& conversion_caches, image_proc::ScratchArena* scratch_arena);
+
+        /**
+         * Stop and join the worker thread, dropping any pending request.
+        */
+        ~RenderWorker();
+
+        /**
+         * Queue an edit to be rendered, replacing any request the worker did not start yet.
+         *
+         * @param source: source image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+         * @param parameters: the edit to be applied
+         * @param preview_size: size of the downscaled proxy to render a preview from (default: none, full resolution)
+         * @param viewport: visible part of the source, rendered first (default: none, the whole image at once)
+         * @return generation number of the request
+        */
+        uint64_t request(const cv::Mat& source, const image_proc::EditParameters& parameters, const cv::Size& preview_size = cv::Size(),
+                         const cv::Rect& viewport = cv::Rect());
+
+        /**
+         * Take the newest finished frame. Older frames that were never taken are dropped.
+         *
+         * @return the frame or nullptr if there is none
+        */
+        std::unique_ptr<Frame> takeFrame();
+
+        /**
+         * Signal emitted on the main loop when a frame is ready to be taken.
+         *
+         * @return the dispatcher to connect to
+        */
+        inline Glib::Dispatcher& signalFrameReady() {return this->frame_ready;}
+    private:
+        struct Request {
+            uint64_t                    generation;
+            cv::Size                    preview_size;
+            cv::Mat                     source;
+            image_proc::EditParameters  parameters;
+            cv::Rect                    viewport;
+        };
+
+        /**
+         * Worker thread loop: wait for the newest request, render it and hand the frame over.
+         *
+         * (internal)
+        */
+        void work();
+
+        /**
+         * Render a request tile by tile, handing over the frame of the visible tiles as soon as they are done.
+         *
+         * (internal)
+         *
+         * @param request: request with a viewport
+         * @return the complete frame or nullptr if a newer request arrived first
+        */
+        std::unique_ptr<Frame> renderTiled(const Request& request);
+
+        /**
+         * Render a preview from the proxy of the source, building the proxy first if there is none of the source yet.
+         *
+         * (internal)
+         *
+         * @param request: request with a preview size
+         * @return the preview frame
+        */
+        std::unique_ptr<Frame> renderPreview(const Request& request);
+
+        /**
+         * Check wether the current render should stop: a newer request is waiting or the worker is stopping.
+         *
+         * (internal)
+         *
+         * @return wether or not there is something newer to do
+        */
+        bool hasNewerRequest();
+
+        /**
+         * Hand a frame over to the main loop.
+         *
+         * (internal)
+         *
+         * @param frame: finished frame
+        */
+        void publish(std::unique_ptr<Frame> frame);
+
+
+        // only used by the worker thread
+        image_proc::EditPipeline    pipeline, preview_pipeline;
+        image_proc::TileRenderer    tile_renderer;
+        image_proc::ConversionCache* conversion_cache;
+        image_proc::ConversionCache* proxy_conversion_cache;
+        image_proc::ScratchArena*   scratch_arena;
+        // downscaled proxy_source, previews render from it
+        cv::Mat                     proxy_source, proxy;
+
+        std::mutex                  request_mutex;
+        std::condition_variable     request_condition;
+        std::unique_ptr<Request>    pending_request;
+        bool                        stopping = false;
+        uint64_t                    next_generation = 0u;
+
+        // lock-free handoff of the newest finished frame
+        std::atomic<Frame*>         finished_frame {nullptr};
+        Glib::Dispatcher            frame_ready;
+
+        std::thread                 thread;
+};
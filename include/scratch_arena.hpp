@@ -0,0 +1,55 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <mutex>
+#include <vector>
+
+#include "macros.hpp"
+
+
+namespace image_proc {
+    /**
+     * Reusable image buffers for the render path, so steady state renders do not allocate (or page fault) at all.
+     * Buffers are ordinary cv::Mat with reference counting: a buffer is handed out again once every image
+     * it was returned as got released (or reassigned), only the arena still referencing it.
+     * Buffers are SCRATCH_ALIGNMENT aligned, large ones are placed on (transparent) huge pages where available.
+     * All methods are thread safe.
+    */
+    class ScratchArena {
+        public:
+            /**
+             * Return a buffer of the given geometry that is not in use anywhere else, allocating one if there is none.
+             *
+             * @param size: wanted image size
+             * @param type: wanted image type
+             * @return the buffer, contents are undefined
+            */
+            cv::Mat acquire(const cv::Size& size, int type);
+
+            /**
+             * Free all buffers that are not in use anymore, e.g. after the image size changed.
+            */
+            void trim();
+
+            /**
+             * Return the number of buffers the arena had to allocate so far.
+             * Stays constant while the same image is being edited.
+             *
+             * @return number of allocations
+            */
+            size_t getAllocationCount() const;
+
+            /**
+             * Return the memory held by the arena, including buffers in use.
+             *
+             * @return number of bytes
+            */
+            size_t getBytes() const;
+        private:
+            mutable std::mutex mutex;
+
+            std::vector<cv::Mat> buffers;
+            size_t nr_allocations = 0ul;
+    };
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <fstream>
+#include <string>
+
+#include "image_proc.hpp"
+
+
+namespace image_proc {
+    /**
+     * Reads a binary PPM (P6, 8bit) row by row, so images larger than the memory can be processed in strips.
+     * PPM stores RGB, the rows need no conversion.
+    */
+    class PpmReader {
+        public:
+            /**
+             * Open a file and parse its header.
+             *
+             * @param filepath: path to the PPM file
+             * @return wether or not the file is a readable 8bit binary PPM
+            */
+            bool open(const std::string& filepath);
+
+            /**
+             * Read the next rows into the top of a buffer.
+             *
+             * @param buffer: continuous CV_8UC3 buffer, as wide as the image
+             * @return number of rows read (at most buffer.rows), 0 at the end of the image, -1 on errors
+            */
+            int read(cv::Mat& buffer);
+
+            /**
+             * Return the size of the opened image.
+             *
+             * @return image size
+            */
+            inline const cv::Size& getSize() const {return this->size;}
+        private:
+            std::ifstream file;
+            cv::Size size;
+            int next_row = 0;
+    };
+
+    /**
+     * Writes a binary PPM (P6, 8bit) row by row.
+    */
+    class PpmWriter {
+        public:
+            /**
+             * Create a file and write its header.
+             *
+             * @param filepath: path to the PPM file
+             * @param size: size of the image to be written
+             * @return wether or not the file could be created
+            */
+            bool open(const std::string& filepath, const cv::Size& size);
+
+            /**
+             * Append rows to the image.
+             *
+             * @param strip: CV_8UC3 rows in RGB, as wide as the image
+             * @return wether or not the rows got written
+            */
+            bool write(const cv::Mat& strip);
+
+            /**
+             * Finish the file.
+             *
+             * @return wether or not all rows of the image got written successfully
+            */
+            bool close();
+        private:
+            std::ofstream file;
+            cv::Size size;
+            int next_row = 0;
+    };
+
+    /**
+     * Result of streamEdits.
+    */
+    struct StreamSummary {
+        int     strip_rows   = 0;
+        // bytes of all buffers used, stays below the memory budget
+        size_t  buffer_bytes = 0ul;
+        ImageStatistics statistics;
+    };
+
+    /**
+     * Apply a complete edit to a PPM file strip by strip, without ever holding the whole image in memory.
+     * Every edit is a pure function of the pixel, so the result is the same as editing the whole image.
+     *
+     * @param input_path: path to the input PPM
+     * @param output_path: path to the output PPM (will be overwritten)
+     * @param parameters: the edit to be applied
+     * @param memory_budget: bytes the strip buffers may use, this bounds the memory regardless of the image size
+     * @param summary: strip geometry and statistics of the output (optional, will be overwritten)
+     * @return wether or not the image was processed completely
+    */
+    bool streamEdits(
+        const std::string& input_path,
+        const std::string& output_path,
+        const EditParameters& parameters,
+        size_t memory_budget,
+        StreamSummary* summary = nullptr
+    );
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <array>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "image_proc.hpp"
+
+
+namespace image_proc {
+    /**
+     * Renders edits tile by tile (TILE_SIZE squares), the tiles within a viewport first, nearest to its center first.
+     * That way the visible part of a large image is done in a time that only depends on the viewport size.
+     * Rendered tiles are cached uncompressed by the edit parameters (least recently used ones are evicted beyond
+     * the budget), so returning to earlier parameters, finishing a render that got interrupted or changing only the
+     * compression does not edit them again; compression is applied per tile while they are put together.
+     * Not thread safe, a renderer belongs to a single render thread.
+    */
+    class TileRenderer {
+        public:
+            /**
+             * Create a renderer with an empty tile cache.
+             *
+             * @param cache_budget: bytes the cached tiles may use
+            */
+            TileRenderer(size_t cache_budget = TILE_CACHE_BUDGET);
+
+            /**
+             * Render the tiles within a viewport.
+             *
+             * @param source: source image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+             * @param converted: source converted into the LIMIT color space (optional, see applyEdits)
+             * @param parameters: the edit to be applied
+             * @param viewport: visible part of the image
+             * @param region_image: output image of the returned region (will be overwritten)
+             * @return the region covered by region_image, viewport extended to whole tiles
+            */
+            cv::Rect renderVisible(const cv::Mat& source, const cv::Mat& converted, const EditParameters& parameters,
+                                   const cv::Rect& viewport, cv::Mat& region_image);
+
+            /**
+             * Render every tile into the complete image, the tiles within the viewport first.
+             *
+             * @param source: source image in RGB, must not be modified afterwards (assign a new cv::Mat instead)
+             * @param converted: source converted into the LIMIT color space (optional, see applyEdits)
+             * @param parameters: the edit to be applied
+             * @param viewport: visible part of the image
+             * @param image: output image (will be overwritten), written in place if size and type already match
+             * @param statistics: statistics of image (will be overwritten)
+             * @param cancelled: polled between tiles, rendering stops once it returns true
+             * @return wether or not every tile got rendered
+            */
+            bool renderAll(const cv::Mat& source, const cv::Mat& converted, const EditParameters& parameters, const cv::Rect& viewport,
+                           cv::Mat& image, ImageStatistics& statistics, const std::function<bool()>& cancelled);
+
+            /**
+             * Return the number of tiles that had to be rendered so far (cache misses).
+             *
+             * @return number of rendered tiles
+            */
+            inline size_t getRenderedTileCount() const {return this->nr_rendered_tiles;}
+        private:
+            // everything the pixels of an edit depend on but the compression, which is applied to the cached tiles afterwards
+            typedef std::array<int, 2 * NR_CHANNELS + 2> EditKey;
+            // edit key and tile index
+            typedef std::pair<EditKey, int> TileKey;
+
+            /**
+             * A rendered tile, edited but not compressed.
+            */
+            struct Tile {
+                TileKey         key;
+                cv::Mat         image;
+                ImageStatistics statistics;
+            };
+
+            struct TileKeyHash {
+                inline size_t operator()(const TileKey& key) const {
+                    size_t hash = std::hash<int>()(key.second);
+                    for (int value: key.first) {
+                        hash ^= std::hash<int>()(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+                    }
+
+                    return hash;
+                }
+            };
+
+            /**
+             * Return the key of an edit, parameters producing identical uncompressed images get identical keys.
+             *
+             * (internal)
+             *
+             * @param parameters: the edit
+             * @return LIMIT: color space and the bounds as applied, Channels: modifier and channel
+            */
+            static EditKey getEditKey(const EditParameters& parameters);
+
+            /**
+             * Take over a new source, dropping the tiles of the old one.
+             *
+             * (internal)
+             *
+             * @param source: source image in RGB
+            */
+            void setSource(const cv::Mat& source);
+
+            /**
+             * Return the tile indices in render order: within the viewport first, each part nearest to its center first.
+             *
+             * (internal)
+             *
+             * @param viewport: visible part of the image
+             * @param nr_visible: output number of tiles within the viewport (they come first)
+             * @return tile indices
+            */
+            std::vector<int> getTileOrder(const cv::Rect& viewport, size_t& nr_visible) const;
+
+            /**
+             * Return the area of a tile within the image.
+             *
+             * (internal)
+             *
+             * @param index: tile index (row major)
+             * @return tile rectangle
+            */
+            cv::Rect getTileRect(int index) const;
+
+            /**
+             * Return a tile from the cache, rendering it on a miss.
+             *
+             * (internal)
+             *
+             * @param converted: source converted into the LIMIT color space (optional)
+             * @param parameters: the edit to be applied (its compression level is ignored)
+             * @param edit_key: key of the edit parameters
+             * @param index: tile index
+             * @return the tile, valid until the next call
+            */
+            const Tile& getTile(const cv::Mat& converted, const EditParameters& parameters, const EditKey& edit_key, int index);
+
+
+            const size_t cache_budget;
+
+            cv::Mat  source;
+            cv::Size nr_tiles;
+
+            // most recently used first
+            std::list<Tile> tiles;
+            std::unordered_map<TileKey, std::list<Tile>::iterator, TileKeyHash> tile_lookup;
+            size_t cache_bytes       = 0ul;
+            size_t nr_rendered_tiles = 0ul;
+    };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "macros.hpp"
+
+
+// time the rest of the enclosing scope as a stage, a single flag check while tracing is disabled
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)   image_proc::ScopedTimer TRACE_CONCAT(scoped_timer_, __LINE__)(name)
+
+
+namespace image_proc {
+    /**
+     * Collects the durations of timed stages of all threads while tracing is enabled.
+     * The events are written as Chrome trace_event JSON (chrome://tracing, Perfetto) when the program exits,
+     * the newest TRACE_WINDOW durations of every stage are kept for a live p50/p99 summary.
+     * Tracing gets enabled by the IMAGE_MANIPULATOR_TRACE environment variable (path of the trace file)
+     * or by the programs' --trace option. All methods are thread safe.
+    */
+    class Tracer {
+        public:
+            typedef std::chrono::steady_clock Clock;
+
+            /**
+             * Rolling summary of a stage.
+            */
+            struct StageSummary {
+                std::string name;
+                // number of runs since tracing got enabled
+                size_t      count;
+                double      p50_ms, p99_ms;
+            };
+
+            /**
+             * Return the tracer of the process.
+             *
+             * @return the tracer
+            */
+            static Tracer& get();
+
+            /**
+             * Write the trace file if tracing is enabled.
+            */
+            ~Tracer();
+
+            /**
+             * Start tracing, should be called before any stage runs.
+             *
+             * @param filepath: path the trace file will be written to
+            */
+            void enable(const std::string& filepath);
+
+            /**
+             * Check wether stages are being timed.
+             *
+             * @return wether or not tracing is enabled
+            */
+            inline bool isEnabled() const {return this->enabled.load(std::memory_order_relaxed);}
+
+            /**
+             * Record a run of a stage on the calling thread.
+             *
+             * @param name: name of the stage, has to outlive the tracer (a string literal)
+             * @param start: start of the run
+             * @param end: end of the run
+            */
+            void record(const char* name, const Clock::time_point& start, const Clock::time_point& end);
+
+            /**
+             * Return the rolling summary of every stage recorded so far, sorted by name.
+             *
+             * @return the summaries
+            */
+            std::vector<StageSummary> getSummary() const;
+
+            /**
+             * Write all events recorded so far as Chrome trace_event JSON.
+             *
+             * @return wether or not the file was written
+            */
+            bool write() const;
+        private:
+            Tracer();
+
+            struct Event {
+                const char* name;
+                uint32_t    thread_id;
+                int64_t     start_ns, duration_ns;
+            };
+
+            struct Samples {
+                std::array<float, TRACE_WINDOW> durations_ms;
+                size_t count = 0ul;
+            };
+
+
+            std::atomic<bool> enabled {false};
+            std::string       filepath;
+            Clock::time_point epoch;
+
+            mutable std::mutex  mutex;
+            std::vector<Event>  events;
+            size_t              nr_dropped_events = 0ul;
+            std::unordered_map<std::string_view, Samples> samples;
+
+            std::atomic<uint32_t> next_thread_id {0u};
+    };
+
+    /**
+     * Times its own lifetime as a run of a stage, use through TRACE_SCOPE.
+    */
+    class ScopedTimer {
+        public:
+            /**
+             * Start timing if tracing is enabled.
+             *
+             * @param name: name of the stage, has to outlive the tracer (a string literal)
+            */
+            inline ScopedTimer(const char* name):
+                name(Tracer::get().isEnabled() ? name : nullptr) {
+
+                if (this->name) {
+                    this->start = Tracer::Clock::now();
+                }
+            }
+
+            /**
+             * Record the run.
+            */
+            inline ~ScopedTimer() {
+                if (this->name) {
+                    Tracer::get().record(this->name, this->start, Tracer::Clock::now());
+                }
+            }
+
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+        private:
+            const char*              name;
+            Tracer::Clock::time_point start;
+    };
+}
@@ -3,10 +3,19 @@
 #include <gtkmm.h>
 
 #include <array>
+#include <map>
+#include <tuple>
 
 #include "macros.hpp"
 #include "image_proc.hpp"
 #include "color_spaces.hpp"
+#include "render_worker.hpp"
+#include "conversion_cache.hpp"
+#include "image_loader.hpp"
+#include "image_saver.hpp"
+#include "image_view.hpp"
+#include "scratch_arena.hpp"
+#include "tracer.hpp"
 
 class Window: public Gtk::Window {
     public:
@@ -18,8 +27,8 @@ class Window: public Gtk::Window {
         
         
         /**
-         * Load an image externally.
-         * Main use is to load an initial image.
+         * Start loading an image in the background, replacing any load still running.
+         * Main use is to load an initial image, the file dialog ends up here as well.
          * 
          * @param filepath: path to the image
         */
@@ -78,6 +87,34 @@ class Window: public Gtk::Window {
          * @param <unused>
         */
         void directActivationBlockingChanged(const Gtk::StateFlags&);
+
+        /**
+         * Callback for the zoom buttons and Ctrl+scrolling over the images.
+         * Only the views' size requests change, drawing picks the mipmap level.
+         * 
+         * @param zoom: new zoom of both image views, 1.0 for 1:1 (gets clamped)
+         * @param anchor_x: horizontal position within the visible area that stays in place (default: center)
+         * @param anchor_y: vertical position within the visible area that stays in place (default: center)
+        */
+        void setZoom(double zoom, double anchor_x = -1.0, double anchor_y = -1.0);
+
+        /**
+         * Callback for the fit button, zooms so the images fill the visible area.
+        */
+        void zoomToFit();
+
+        /**
+         * Callback for scrolling over the images, zooms while Ctrl is held.
+         * 
+         * @param event: the scroll event
+         * @return wether or not the event was handled (otherwise it scrolls)
+        */
+        bool imageScrolled(GdkEventScroll* event);
+
+        /**
+         * Callback for scrolling the images, renders the newly visible tiles of a tiled render still in progress first.
+        */
+        void imageViewportChanged();
         /* #endregion       button handlers */
 
         /* #region          other */
@@ -97,12 +134,63 @@ class Window: public Gtk::Window {
         void changedAdjustment(size_t channel_idx, bool called_from_min);
 
         /**
-         * Callback to resize limit preview when its scrolled windows size allocation changes.
+         * Callback for a changed size allocation of a limit preview's scrolled window.
+         * Resizes are debounced, the previews follow once the allocations settled.
+         * 
+         * @param <unused>
+         * @param <unused>
+        */
+        void limitPreviewChangedSize(Gtk::Allocation&, const size_t&);
+
+        /**
+         * Show the limit previews of the current color space at the height of their scales.
+         * 
+         * @return false, so it can be used as one shot timeout
+        */
+        bool updateLimitPreviews();
+
+        /**
+         * Return the height a limit preview gets shown at: the height of its scale.
+         * 
+         * @param channel_idx: channel index within the color space
+         * @return height in pixels, STD_PREVIEW_HEIGHT while the scale is not allocated yet
+        */
+        int getLimitPreviewHeight(size_t channel_idx);
+
+        /**
+         * (Re)start the timeout after which an interactive edit gets rendered in full resolution.
+        */
+        void scheduleFullRender();
+
+        /**
+         * Render the current edit in full resolution after previews were shown while dragging.
+         * 
+         * @return false, so it can be used as one shot timeout
+        */
+        bool finishInteractiveEdit();
+
+        /**
+         * Callback for releasing a slider, ends a drag immediately.
          * 
          * @param <unused>
-         * @param channel_idx: index of the channel the callback gets called on
+         * @return false, so the scale still handles the event
         */
-        void limitPreviewChangedSize(Gtk::Allocation&, const size_t& channel_idx);
+        bool scaleReleased(GdkEventButton*);
+
+        /**
+         * Refresh the stage timing overlay with the rolling p50/p99 of every traced stage.
+         * 
+         * @return true, so it can be used as periodic timeout
+        */
+        bool updateTraceOverlay();
+
+        /**
+         * Draw the window, overridden to time the Gtk redraw.
+         * 
+         * @param context: cairo context to draw on
+         * @return wether or not the event was handled
+        */
+        bool on_draw(const Cairo::RefPtr<Cairo::Context>& context) override;
         /* #endregion       other */
         /* #endregion   signal handlers */
 
@@ -110,31 +198,116 @@ class Window: public Gtk::Window {
         /**
          * Callback to apply the changes made in LIMIT tab.
          * Also applies compression.
+         * 
+         * @param preview: render from the screen sized proxy instead of the full resolution image
         */
-        void applyLimitEdits();
+        void applyLimitEdits(bool preview = false);
 
         /**
          * Callback to apply the changed made in Channels tab.
          * Also applies compression.
+         * 
+         * @param preview: render from the screen sized proxy instead of the full resolution image
         */
-        void applyChannelEdits();
+        void applyChannelEdits(bool preview = false);
+
+        /**
+         * Return the size of the visible area the altered image gets (about half of the image area).
+         * 
+         * @return visible size in pixels
+        */
+        cv::Size getVisibleImageSize();
+
+        /**
+         * Return the size of the proxy previews render from: the original image downscaled to the visible area.
+         * 
+         * @return proxy size or an empty size if the original image already fits
+        */
+        cv::Size getPreviewSize();
+
+        /**
+         * Queue a render of the current image, large images render the visible tiles first.
+         *
+         * (internal)
+         *
+         * @param parameters: the edit to be applied
+         * @param preview: render from the screen sized proxy instead of the full resolution image
+         * @return generation number of the request
+        */
+        uint64_t requestRender(const image_proc::EditParameters& parameters, bool preview);
+
+        /**
+         * Return the part of the original image the altered image shows, for tiled rendering.
+         *
+         * @return visible part in image coordinates, empty for images too small to be tiled or shown completely
+        */
+        cv::Rect getViewport();
+
+        /**
+         * Collect the current state of the editing widgets.
+         * 
+         * @param mode: which tab's parameters are to be used
+         * @return snapshot of the edit parameters
+        */
+        image_proc::EditParameters getEditParameters(const image_proc::EditMode& mode) const;
+
+        /**
+         * Callback for the render worker, displays the newest finished frame.
+        */
+        void renderFinished();
         /* #endregion   apply functions */
 
         /* #region      image load/save */
         /**
-         * Callback to save the image into a chosen location.
+         * Callback to save the image into a chosen location. The latest edit gets rendered completely first,
+         * the image gets written in the background once that frame arrived.
         */
         void saveImage();
 
+        /**
+         * Callback for the image saver, reports finished saves.
+        */
+        void saveFinished();
+
+        /**
+         * Run the activity spinner while an image is being loaded or saved.
+        */
+        void updateActivity();
+
         /**
          * Callback to load the image from a chosen file.
         */
         void loadImage();
 
         /**
-         * Instantiate the previews if they aren't already.
+         * Callback for the image loader, shows a reduced first paint or takes over the fully loaded image.
+        */
+        void imageLoaded();
+
+        /**
+         * Generate the previews of every color space at the current heights of the scales into the cache, in parallel.
+         * Runs once the main loop is idle, after startup and after the scales got resized.
+        */
+        void generatePreviews();
+
+        /**
+         * Return a limit preview of a given height, generated once and cached afterwards.
+         * 
+         * @param color_space: color space of the channel
+         * @param channel_idx: channel index within the color space
+         * @param height: height in pixels
+         * @return the preview, its pixels stay unchanged
+        */
+        const cv::Mat& getLimitPreview(const image_proc::ColorSpace& color_space, size_t channel_idx, int height);
+
+        /**
+         * Make room in the preview cache once it is full, dropping the previews of other heights.
+         * 
+         * (internal)
+         * 
+         * @param height: height of the previews to keep
         */
-        void getPreviews();
+        void trimLimitPreviewCache(int height);
         /* #endregion   image load/save */
 
         /* #region      members */
@@ -165,11 +338,12 @@ class Window: public Gtk::Window {
         uint8_t channel_blocked_flags = 0u;
         bool direct_activation_blocked = false;
         
-        // preview handling
-        cv::Mat default_preview_image = cv::Mat(STD_PREVIEW_HEIGHT, STD_PREVIEW_WIDTH, CV_8UC3, cv::Scalar(0.0, 0.0, 0.0));
-        std::array<std::array<cv::Mat, NR_CHANNELS>, image_proc::ColorSpace::LAST> limit_preview_references;
+        // preview handling, the shown previews are exactly as high as the scales
+        std::array<cv::Mat, NR_CHANNELS> limit_preview_shown;
+        // previews by (color space, channel, height), so returning to a size or color space does not generate them again
+        std::map<std::tuple<image_proc::ColorSpace, size_t, int>, cv::Mat> limit_preview_cache;
+        sigc::connection limit_preview_resize_timeout;
         std::array<Gtk::Image, NR_CHANNELS> limit_preview_images;
-        const double limit_preview_aspect_ratio = static_cast<double>(STD_PREVIEW_WIDTH) / static_cast<double>(STD_PREVIEW_HEIGHT);
 
         Gtk::ComboBox limit_color_space_selector;
         Gtk::Switch direct_application_switch;
@@ -198,10 +372,45 @@ class Window: public Gtk::Window {
         // Gtk widgets to keep track of
         Gtk::Switch hv_switch;
         Gtk::Label average_label;
+        Gtk::Spinner activity_spinner;
+
+        // stage timings shown on top of the images while tracing
+        Gtk::Overlay image_overlay;
+        Gtk::Label   trace_label;
 
+        Gtk::ScrolledWindow image_scroll_window;
         Gtk::Box   images_box;
-        Gtk::Image original_image_widget, altered_image_widget;
+        ImageView  original_image_widget, altered_image_widget;
         cv::Mat    original_image,        altered_image;
+
+        // decodes chosen files off the main loop, loading_image is the reduced first paint shown meanwhile
+        ImageLoader image_loader;
+        cv::Mat     loading_image;
+        bool        loading = false;
+
+        // encodes and writes the saved frames off the main loop, with the settings last chosen in the save dialog
+        ImageSaver                  image_saver;
+        image_proc::EncoderSettings encoder_settings;
+        // save waiting for the complete frame of the latest edit (empty file path for none)
+        std::string                 pending_save_filepath;
+        uint64_t                    pending_save_generation = 0u;
+
+        // preview rendered from the downscaled original image while a slider is being dragged
+        cv::Mat preview_image;
+        sigc::connection full_render_timeout;
+
+        // LIMIT color space conversions of original_image and of the render worker's proxy
+        image_proc::ConversionCache conversion_cache, proxy_conversion_cache;
+
+        // frame images of the render worker, reused once altered_image and preview_image let go of them
+        image_proc::ScratchArena scratch_arena;
+
+        // renders the edits off the main loop, original_image must only be replaced, never modified in place
+        RenderWorker render_worker {{&this->conversion_cache, &this->proxy_conversion_cache}, &this->scratch_arena};
+        // edit of the latest request, requested again on scrolling and saving
+        image_proc::EditParameters requested_parameters;
+        // tiled render whose complete frame did not arrive yet (generation 0 for none)
+        uint64_t                   tiled_generation = 0u;
         /* #endregion       image side*/
         /* #endregion   members*/
 };
\ No newline at end of file
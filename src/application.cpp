@@ -36,6 +36,12 @@ int Application::on_command_line(const Glib::RefPtr<Gio::ApplicationCommandLine>
     entry.set_description("The initial image do be manipulated.");
     entry.set_arg_description("Path to the image file.");
     group.add_entry_filename(entry, sigc::mem_fun3(*this, &Application::parse_image_path));
+
+    Glib::OptionEntry trace_entry;
+    trace_entry.set_long_name("trace");
+    trace_entry.set_description("Time the processing stages, write them as Chrome trace to the file on exit and show p50/p99 per stage.");
+    trace_entry.set_arg_description("Path to the trace file.");
+    group.add_entry_filename(trace_entry, this->trace_path);
     
     // add GTK(mm) options, --help-gtk, etc
     Glib::OptionGroup gtk_group(gtk_get_option_group(true));
@@ -56,6 +62,10 @@ int Application::on_command_line(const Glib::RefPtr<Gio::ApplicationCommandLine>
         return 1;
     }
 
+    if (!this->trace_path.empty()) {
+        image_proc::Tracer::get().enable(this->trace_path);
+    }
+
     this->activate();
 
     return 0;
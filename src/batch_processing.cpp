@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+#include "batch_processing.hpp"
+#include "tracer.hpp"
+
+
+const std::array<const std::string, 9> image_extensions {
+    ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".webp", ".ppm", ".pgm"
+};
+
+/**
+ * Check wether a path has one of the known image extensions (case insensitive).
+ *
+ * @param path: path to be checked
+ * @return wether or not the extension is known
+*/
+bool hasImageExtension(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {return std::tolower(c);});
+
+    return std::find(image_extensions.begin(), image_extensions.end(), extension) != image_extensions.end();
+}
+
+std::vector<std::string> batch_processing::collectInputs(const std::vector<std::string>& inputs) {
+    std::vector<std::string> filepaths;
+
+    for (const std::string& input: inputs) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(input, error)) {
+            filepaths.push_back(input);
+
+            continue;
+        }
+
+        for (const std::filesystem::directory_entry& entry: std::filesystem::directory_iterator(input, error)) {
+            if (entry.is_regular_file(error) && hasImageExtension(entry.path())) {
+                filepaths.push_back(entry.path().string());
+            }
+        }
+
+        if (error) {
+            std::cerr << "Unable to read directory " << input << ": " << error.message() << std::endl;
+        }
+    }
+
+    std::sort(filepaths.begin(), filepaths.end());
+
+    return filepaths;
+}
+
+std::string batch_processing::findDuplicateFilename(const std::vector<std::string>& filepaths) {
+    std::vector<std::string> filenames;
+    filenames.reserve(filepaths.size());
+    for (const std::string& filepath: filepaths) {
+        filenames.push_back(std::filesystem::path(filepath).filename().string());
+    }
+
+    std::sort(filenames.begin(), filenames.end());
+    const auto duplicate = std::adjacent_find(filenames.begin(), filenames.end());
+
+    return duplicate != filenames.end() ? *duplicate : std::string();
+}
+
+
+batch_processing::BatchProcessor::BatchProcessor(const image_proc::EditParameters& parameters, const std::string& output_directory, size_t nr_workers, size_t lattice_size,
+                                                 const image_proc::EncoderSettings& encoder_settings):
+    edit_lut(parameters, lattice_size, true),
+    encoder_settings(encoder_settings),
+    output_directory(output_directory),
+    nr_workers(nr_workers ? nr_workers : std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+batch_processing::Summary batch_processing::BatchProcessor::run(const std::vector<std::string>& filepaths) {
+    this->filepaths = &filepaths;
+    this->next_index = 0ul;
+    this->processed  = 0ul;
+    this->failed     = 0ul;
+
+    // the pool already keeps every core busy, nested OpenCV threading would only oversubscribe
+    const int previous_nr_threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    const size_t nr_workers = std::min(this->nr_workers, filepaths.size());
+    workers.reserve(nr_workers);
+    for (size_t i = 0ul; i < nr_workers; i++) {
+        workers.emplace_back(&BatchProcessor::work, this);
+    }
+    for (std::thread& worker: workers) {
+        worker.join();
+    }
+
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+    cv::setNumThreads(previous_nr_threads);
+    this->filepaths = nullptr;
+
+    Summary summary;
+    summary.processed = this->processed;
+    summary.failed    = this->failed;
+    summary.seconds   = duration.count();
+
+    return summary;
+}
+
+void batch_processing::BatchProcessor::work() {
+    for (size_t idx = this->next_index++; idx < this->filepaths->size(); idx = this->next_index++) {
+        if (this->processImage((*this->filepaths)[idx])) {
+            this->processed++;
+        } else {
+            this->failed++;
+        }
+    }
+}
+
+bool batch_processing::BatchProcessor::processImage(const std::string& filepath) const {
+    TRACE_SCOPE("BatchProcessor::processImage");
+
+    const std::filesystem::path output_path = std::filesystem::path(this->output_directory) / std::filesystem::path(filepath).filename();
+
+    std::error_code error;
+    if (std::filesystem::equivalent(filepath, output_path, error)) {
+        std::lock_guard<std::mutex> lock(this->log_mutex);
+        std::cerr << "Refusing to overwrite input " << filepath << ". Skipping." << std::endl;
+
+        return false;
+    }
+
+    // stays in BGR from decoding to encoding, the lookup table is compiled for it
+    cv::Mat image;
+    {
+        TRACE_SCOPE("imread");
+        image = cv::imread(filepath);
+    }
+    if (image.empty()) {
+        std::lock_guard<std::mutex> lock(this->log_mutex);
+        std::cerr << "Unable to load file " << filepath << ". Skipping." << std::endl;
+
+        return false;
+    }
+
+    this->edit_lut.apply(image, image);
+
+    if (!image_proc::saveImage(image, output_path.string(), this->encoder_settings, true)) {
+        std::lock_guard<std::mutex> lock(this->log_mutex);
+        std::cerr << "Unable to save file " << output_path.string() << ". Skipping." << std::endl;
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,407 @@
+#include <strings.h>
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include "batch_processing.hpp"
+#include "strip_stream.hpp"
+#include "tracer.hpp"
+
+
+const char* usage =
+    "Usage: batch_processor [options] <image file or directory>...\n"
+    "\n"
+    "Applies one edit to every given image without opening a window.\n"
+    "\n"
+    "Options:\n"
+    "  -o, --output DIR            directory the results are written to (required)\n"
+    "  -j, --jobs N                number of workers (default: one per hardware thread)\n"
+    "  -m, --mode MODE             limit or channels (default: limit)\n"
+    "  -s, --color-space NAME      LIMIT color space, e.g. RGB, HSV, Lab (default: RGB)\n"
+    "  -l, --limits B0,T0,B1,T1,B2,T2\n"
+    "                              LIMIT bounds per channel (default: 0,255,0,255,0,255)\n"
+    "      --modifier MODIFIER     min, avg, max, red, green, blue, hue, sat or val (default: avg)\n"
+    "      --channel CHANNEL       all, r, g or b (default: all)\n"
+    "  -c, --compression LEVEL     compression level from 1.0 to 8.0 (default: 8.0)\n"
+    "      --lattice N             lookup table samples per axis from 2 to 256, smaller lattices are\n"
+    "                              interpolated and approximate (default: 256, exact)\n"
+    "      --png-compression N     zlib level from 0 (fastest) to 9 (smallest) (default: the encoder's,\n"
+    "                              level 1 tuned for speed)\n"
+    "      --png-strategy NAME     default, filtered, huffman, rle or fixed (default: the encoder's)\n"
+    "      --jpeg-quality N        JPEG quality from 0 to 100 (default: 95)\n"
+    "      --jpeg-optimize         optimize the JPEG huffman tables (smaller, slower)\n"
+    "      --stream MB             stream binary PPM inputs strip by strip within MB megabytes of buffers,\n"
+    "                              for images larger than the memory (one image at a time, no --jobs,\n"
+    "                              --lattice or encoder options)\n"
+    "      --trace FILE            time the processing stages and write them as Chrome trace JSON to FILE\n"
+    "  -h, --help                  show this help\n";
+
+const std::array<const std::pair<const char*, image_proc::ModifierOption>, 9> modifier_names {{
+    {"min", image_proc::ModifierOption::MIN},   {"avg",   image_proc::ModifierOption::AVG},   {"max",  image_proc::ModifierOption::MAX},
+    {"red", image_proc::ModifierOption::RED},   {"green", image_proc::ModifierOption::GREEN}, {"blue", image_proc::ModifierOption::BLUE},
+    {"hue", image_proc::ModifierOption::HUE},   {"sat",   image_proc::ModifierOption::SAT},   {"val",  image_proc::ModifierOption::VAL},
+}};
+const std::array<const std::pair<const char*, int>, 5> png_strategy_names {{
+    {"default", cv::IMWRITE_PNG_STRATEGY_DEFAULT},  {"filtered", cv::IMWRITE_PNG_STRATEGY_FILTERED},
+    {"huffman", cv::IMWRITE_PNG_STRATEGY_HUFFMAN_ONLY},
+    {"rle",     cv::IMWRITE_PNG_STRATEGY_RLE},      {"fixed",    cv::IMWRITE_PNG_STRATEGY_FIXED},
+}};
+const std::array<const std::pair<const char*, image_proc::ChannelOption>, 4> channel_names {{
+    {"all", image_proc::ChannelOption::ALL},
+    {"r",   image_proc::ChannelOption::R},      {"g",     image_proc::ChannelOption::G},      {"b",    image_proc::ChannelOption::B},
+}};
+
+
+/**
+ * Parse the comma separated LIMIT bounds.
+ *
+ * @param value: argument string
+ * @param limits: output bounds (only overwritten on success)
+ * @return wether or not the argument is valid
+*/
+bool parseLimits(const std::string& value, std::array<double, 2 * NR_CHANNELS>& limits) {
+    std::array<double, 2 * NR_CHANNELS> parsed;
+    std::stringstream stream(value);
+    std::string item;
+
+    for (size_t i = 0ul; i < parsed.size(); i++) {
+        if (!std::getline(stream, item, ',')) {
+            return false;
+        }
+
+        try {
+            parsed[i] = std::stod(item);
+        } catch (const std::exception&) {
+            return false;
+        }
+
+        if (!std::isfinite(parsed[i])) {
+            return false;
+        }
+    }
+
+    if (std::getline(stream, item, ',')) {
+        return false;
+    }
+
+    limits = parsed;
+
+    return true;
+}
+
+/**
+ * Parse the command line into edit parameters.
+ *
+ * @param argc: argument count
+ * @param argv: argument values
+ * @param parameters: output edit parameters
+ * @param output_directory: output directory
+ * @param nr_workers: output number of workers
+ * @param lattice_size: output lookup table samples per axis
+ * @param encoder_settings: output encoder settings
+ * @param stream_budget: output memory budget in bytes for streaming, 0 to process whole images
+ * @param inputs: output list of positional inputs
+ * @return wether or not the command line is valid
+*/
+bool parseArguments(int argc, char* argv[], image_proc::EditParameters& parameters, std::string& output_directory, size_t& nr_workers, size_t& lattice_size,
+                    image_proc::EncoderSettings& encoder_settings, size_t& stream_budget, std::vector<std::string>& inputs) {
+    // last given option streaming has no use for, the strips are written as binary PPM by a single worker
+    std::string whole_image_option;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+
+        if (argument == "-h" || argument == "--help") {
+            std::cout << usage;
+
+            exit(0);
+        }
+
+        if (argument[0] != '-') {
+            inputs.push_back(argument);
+
+            continue;
+        }
+
+        if (argument == "--jpeg-optimize") {
+            encoder_settings.jpeg_optimize = true;
+            whole_image_option = argument;
+
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Option " << argument << " takes in one argument" << std::endl;
+
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        if (argument == "-j" || argument == "--jobs" || argument == "--lattice" || argument == "--png-compression" ||
+            argument == "--png-strategy" || argument == "--jpeg-quality") {
+            whole_image_option = argument;
+        }
+
+        if (argument == "-o" || argument == "--output") {
+            output_directory = value;
+        } else if (argument == "-j" || argument == "--jobs") {
+            try {
+                nr_workers = std::stoul(value);
+            } catch (const std::exception&) {
+                std::cerr << "Invalid number of workers: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "-m" || argument == "--mode") {
+            if (value == "limit") {
+                parameters.mode = image_proc::EditMode::LIMIT;
+            } else if (value == "channels") {
+                parameters.mode = image_proc::EditMode::CHANNELS;
+            } else {
+                std::cerr << "Unknown mode: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "-s" || argument == "--color-space") {
+            size_t idx = 0ul;
+            while (idx < image_proc::ColorSpace::LAST && strcasecmp(image_proc::color_space_names[idx].c_str(), value.c_str())) {
+                idx++;
+            }
+
+            if (idx == image_proc::ColorSpace::LAST) {
+                std::cerr << "Unknown color space: " << value << std::endl;
+
+                return false;
+            }
+            parameters.color_space = static_cast<image_proc::ColorSpace>(idx);
+        } else if (argument == "-l" || argument == "--limits") {
+            if (!parseLimits(value, parameters.limits)) {
+                std::cerr << "Limits need to be given as B0,T0,B1,T1,B2,T2, got: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "--modifier") {
+            size_t idx = 0ul;
+            while (idx < modifier_names.size() && value != modifier_names[idx].first) {
+                idx++;
+            }
+
+            if (idx == modifier_names.size()) {
+                std::cerr << "Unknown modifier: " << value << std::endl;
+
+                return false;
+            }
+            parameters.modifier = modifier_names[idx].second;
+        } else if (argument == "--channel") {
+            size_t idx = 0ul;
+            while (idx < channel_names.size() && value != channel_names[idx].first) {
+                idx++;
+            }
+
+            if (idx == channel_names.size()) {
+                std::cerr << "Unknown channel: " << value << std::endl;
+
+                return false;
+            }
+            parameters.channel = channel_names[idx].second;
+        } else if (argument == "-c" || argument == "--compression") {
+            try {
+                parameters.compression_level = std::stod(value);
+            } catch (const std::exception&) {
+                parameters.compression_level = 0.0;
+            }
+
+            // every comparison with NaN is false, it would pass the range check
+            if (!std::isfinite(parameters.compression_level) || parameters.compression_level < 1.0 || parameters.compression_level > 8.0) {
+                std::cerr << "Compression level needs to be between 1.0 and 8.0, got: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "--lattice") {
+            try {
+                lattice_size = std::stoul(value);
+            } catch (const std::exception&) {
+                lattice_size = 0ul;
+            }
+
+            if (lattice_size < 2ul || lattice_size > image_proc::EditLut::FULL_LATTICE) {
+                std::cerr << "Lattice size needs to be between 2 and 256, got: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "--trace") {
+            image_proc::Tracer::get().enable(value);
+        } else if (argument == "--stream") {
+            try {
+                stream_budget = std::stoul(value) * 1024ul * 1024ul;
+            } catch (const std::exception&) {
+                stream_budget = 0ul;
+            }
+
+            if (!stream_budget) {
+                std::cerr << "Invalid memory budget: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "--png-compression") {
+            try {
+                encoder_settings.png_compression = std::stoi(value);
+            } catch (const std::exception&) {
+                encoder_settings.png_compression = -1;
+            }
+
+            if (encoder_settings.png_compression < 0 || encoder_settings.png_compression > 9) {
+                std::cerr << "PNG compression needs to be between 0 and 9, got: " << value << std::endl;
+
+                return false;
+            }
+        } else if (argument == "--png-strategy") {
+            size_t idx = 0ul;
+            while (idx < png_strategy_names.size() && value != png_strategy_names[idx].first) {
+                idx++;
+            }
+
+            if (idx == png_strategy_names.size()) {
+                std::cerr << "Unknown PNG strategy: " << value << std::endl;
+
+                return false;
+            }
+            encoder_settings.png_strategy = png_strategy_names[idx].second;
+        } else if (argument == "--jpeg-quality") {
+            try {
+                encoder_settings.jpeg_quality = std::stoi(value);
+            } catch (const std::exception&) {
+                encoder_settings.jpeg_quality = -1;
+            }
+
+            if (encoder_settings.jpeg_quality < 0 || encoder_settings.jpeg_quality > 100) {
+                std::cerr << "JPEG quality needs to be between 0 and 100, got: " << value << std::endl;
+
+                return false;
+            }
+        } else {
+            std::cerr << "Unable to parse argument: " << argument << std::endl;
+
+            return false;
+        }
+    }
+
+    if (output_directory.empty()) {
+        std::cerr << "No output directory given (--output)" << std::endl;
+
+        return false;
+    }
+    if (inputs.empty()) {
+        std::cerr << "No input images given" << std::endl;
+
+        return false;
+    }
+    if (stream_budget && !whole_image_option.empty()) {
+        std::cerr << "Option " << whole_image_option << " can not be combined with --stream" << std::endl;
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Stream every image strip by strip, one image at a time.
+ *
+ * @param filepaths: binary PPM images to be processed
+ * @param output_directory: directory the results get written to (same file names as the inputs)
+ * @param parameters: the edit to be applied
+ * @param stream_budget: bytes the strip buffers may use
+ * @return exit code
+*/
+int streamImages(const std::vector<std::string>& filepaths, const std::string& output_directory, const image_proc::EditParameters& parameters, size_t stream_budget) {
+    size_t failed = 0ul;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (const std::string& filepath: filepaths) {
+        const std::filesystem::path output_path = std::filesystem::path(output_directory) / std::filesystem::path(filepath).filename();
+
+        std::error_code error;
+        if (std::filesystem::equivalent(filepath, output_path, error)) {
+            std::cerr << "Refusing to overwrite input " << filepath << ". Skipping." << std::endl;
+            failed++;
+
+            continue;
+        }
+
+        image_proc::StreamSummary summary;
+        if (!image_proc::streamEdits(filepath, output_path.string(), parameters, stream_budget, &summary)) {
+            failed++;
+
+            continue;
+        }
+
+        std::clog << filepath << ": " << summary.statistics.nr_pixels << " pixels in strips of " << summary.strip_rows << " rows ("
+                  << summary.buffer_bytes / (1024ul * 1024ul) << "MB of buffers), average " << image_proc::getAverageColorString(summary.statistics) << std::endl;
+    }
+
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    std::clog << "Streamed " << filepaths.size() - failed << " of " << filepaths.size() << " images in " << duration.count() << 's';
+    if (failed) {
+        std::clog << ", " << failed << " failed";
+    }
+    std::clog << std::endl;
+
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    image_proc::EditParameters parameters;
+    std::string output_directory;
+    size_t nr_workers = 0ul, lattice_size = image_proc::EditLut::FULL_LATTICE;
+    image_proc::EncoderSettings encoder_settings;
+    size_t stream_budget = 0ul;
+    std::vector<std::string> inputs;
+
+    if (!parseArguments(argc, argv, parameters, output_directory, nr_workers, lattice_size, encoder_settings, stream_budget, inputs)) {
+        std::cerr << '\n' << usage;
+
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(output_directory, error);
+    if (error) {
+        std::cerr << "Unable to create output directory " << output_directory << ": " << error.message() << std::endl;
+
+        return 1;
+    }
+
+    const std::vector<std::string> filepaths = batch_processing::collectInputs(inputs);
+    if (filepaths.empty()) {
+        std::cerr << "No images found." << std::endl;
+
+        return 1;
+    }
+
+    const std::string duplicate = batch_processing::findDuplicateFilename(filepaths);
+    if (!duplicate.empty()) {
+        std::cerr << "Several inputs are named " << duplicate << ", their results would overwrite each other." << std::endl;
+
+        return 1;
+    }
+
+    if (stream_budget) {
+        return streamImages(filepaths, output_directory, parameters, stream_budget);
+    }
+
+    batch_processing::BatchProcessor processor(parameters, output_directory, nr_workers, lattice_size, encoder_settings);
+    const batch_processing::Summary summary = processor.run(filepaths);
+
+    std::clog << "Processed " << summary.processed << " of " << filepaths.size() << " images in "
+              << summary.seconds << "s (" << summary.imagesPerSecond() << " images/s)";
+    if (summary.failed) {
+        std::clog << ", " << summary.failed << " failed";
+    }
+    std::clog << std::endl;
+
+    return summary.failed ? 1 : 0;
+}
@@ -0,0 +1,945 @@
+#include <opencv2/opencv.hpp>
+#include <gtkmm.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "image_proc.hpp"
+#include "edit_lut.hpp"
+#include "kernels.hpp"
+#include "limit_index.hpp"
+#include "palette.hpp"
+#include "raw_image_cache.hpp"
+#include "scratch_arena.hpp"
+#include "strip_stream.hpp"
+#include "tile_renderer.hpp"
+
+
+const char* usage =
+    "Usage: bench_image_proc [options]\n"
+    "\n"
+    "Benchmarks every image_proc entry point on synthetic images and writes the results as JSON.\n"
+    "\n"
+    "Options:\n"
+    "  -s, --sizes WxH,...         image sizes (default: 640x480,1920x1080,4000x3000,6000x4000,8660x5774)\n"
+    "  -t, --min-time SECONDS      minimal measuring time per case (default: 0.5)\n"
+    "  -r, --min-repetitions N     minimal number of measured runs per case (default: 3)\n"
+    "  -f, --filter TEXT           only run cases whose name/variant contains TEXT (ignoring case)\n"
+    "  -o, --output FILE           write the JSON to FILE instead of stdout\n"
+    "      --legacy                also run the replaced implementations for comparison\n"
+    "  -h, --help                  show this help\n";
+
+const std::array<const std::pair<const char*, image_proc::ModifierOption>, 9> modifier_names {{
+    {"MIN", image_proc::ModifierOption::MIN},   {"AVG",   image_proc::ModifierOption::AVG},   {"MAX",  image_proc::ModifierOption::MAX},
+    {"RED", image_proc::ModifierOption::RED},   {"GREEN", image_proc::ModifierOption::GREEN}, {"BLUE", image_proc::ModifierOption::BLUE},
+    {"HUE", image_proc::ModifierOption::HUE},   {"SAT",   image_proc::ModifierOption::SAT},   {"VAL",  image_proc::ModifierOption::VAL},
+}};
+const std::array<const std::pair<const char*, image_proc::ChannelOption>, 4> channel_names {{
+    {"ALL", image_proc::ChannelOption::ALL},
+    {"R",   image_proc::ChannelOption::R},      {"G",     image_proc::ChannelOption::G},      {"B",    image_proc::ChannelOption::B},
+}};
+const std::array<const double, 5> compression_levels {1.0, 2.5, 4.0, 7.3, 8.0};
+
+
+/* #region      legacy implementations */
+/**
+ * The multi pass LIMIT implementation the fused kernel replaced, kept as reference for speed and output.
+*/
+void legacyLimitImageByChannels(const cv::Mat& src, cv::Mat& dst, const image_proc::ColorSpace& color_space,
+                                const double bottom0, const double top0, const double bottom1, const double top1, const double bottom2, const double top2) {
+    const cv::Scalar lower_boundary(bottom0, bottom1, bottom2),
+                     upper_boundary(top0,    top1,    top2);
+
+    cv::Mat mask, temp;
+    if (color_space) {
+        cv::cvtColor(src, temp, image_proc::convert_from_rgb[color_space]);
+        cv::inRange(temp, lower_boundary, upper_boundary, mask);
+    } else {
+        cv::copyTo(src, temp, cv::noArray());
+        cv::inRange(temp, lower_boundary, upper_boundary, mask);
+    }
+
+    cv::Mat gray, foreground, background;
+    cv::cvtColor(temp, gray, cv::COLOR_RGB2GRAY);
+    cv::cvtColor(gray, gray, cv::COLOR_GRAY2RGB);
+
+    cv::bitwise_or(temp, temp, foreground, mask);
+    cv::bitwise_not(mask, mask);
+    cv::bitwise_or(gray, gray, background, mask);
+    cv::bitwise_or(foreground, background, dst);
+}
+
+/**
+ * The per pixel compression compressImage used before it switched to lookup tables.
+*/
+void legacyCompressImage(const cv::Mat& src, cv::Mat& dst, double compression_level) {
+    src.copyTo(dst);
+
+    if (compression_level == 8.0) {
+        return;
+    }
+
+    dst.forEach<image_proc::Pixel>(
+        [compression_level](image_proc::Pixel& pixel, const int*) -> void {
+            uint8_t pixel_0 = pixel[0] * (compression_level / 0xFF),
+                    pixel_1 = pixel[1] * (compression_level / 0xFF),
+                    pixel_2 = pixel[2] * (compression_level / 0xFF);
+
+            pixel[0] = pixel_0 * 0xFF / compression_level;
+            pixel[1] = pixel_1 * 0xFF / compression_level;
+            pixel[2] = pixel_2 * 0xFF / compression_level;
+        }
+    );
+}
+
+/**
+ * Iterate over every pixel and set selected channels to the minimum value of that pixel.
+ * 
+ * @param src: Source image in RGB color space
+ * @param dst: Output image (will be overwritten)
+ * @param output_channel: wether to choose channel 0, 1, 2 or all (-1)
+*/
+void legacySetChannelsToMin(const cv::Mat& src, cv::Mat& dst, const image_proc::ChannelOption& output_channel) {
+    src.copyTo(dst);
+
+    if (output_channel == image_proc::ChannelOption::ALL) {
+        dst.forEach<image_proc::Pixel>(
+            [](image_proc::Pixel& pixel, const int*) -> void {
+                uint8_t min = std::min(pixel[0], pixel[1]);
+                min = std::min(min, pixel[2]);
+
+                pixel[0] = min; pixel[1] = min; pixel[2] = min;
+            }
+        );
+    } else {
+        dst.forEach<image_proc::Pixel>(
+            [output_channel](image_proc::Pixel& pixel, const int*) -> void {
+                uint8_t min = std::min(pixel[0], pixel[1]);
+                min = std::min(min, pixel[2]);
+
+                pixel[output_channel] = min;
+                pixel[(output_channel + 1) % 3] = 0;
+                pixel[(output_channel + 2) % 3] = 0;
+            }
+        );
+    }
+}
+
+/**
+ * Iterate over every pixel and set selected channels to average of all values of that pixel.
+ * 
+ * @param src: Source image in RGB color space
+ * @param dst: Output image (will be overwritten)
+ * @param output_channel: wether to choose channel 0, 1, 2 or all (-1)
+*/
+void legacySetChannelsToAvg(const cv::Mat& src, cv::Mat& dst, const image_proc::ChannelOption& output_channel) {
+    src.copyTo(dst);
+
+    if (output_channel == image_proc::ChannelOption::ALL) {
+        dst.forEach<image_proc::Pixel>(
+            [](image_proc::Pixel& pixel, const int*) -> void {
+                uint8_t avg = (pixel[0] + pixel[1] + pixel[2]) / 3u;
+
+                pixel[0] = avg; pixel[1] = avg; pixel[2] = avg;
+            }
+        );
+    } else {
+        dst.forEach<image_proc::Pixel>(
+            [output_channel](image_proc::Pixel& pixel, const int*) -> void {
+                uint8_t avg = (pixel[0] + pixel[1] + pixel[2]) / 3u;
+
+                pixel[output_channel] = avg;
+                pixel[(output_channel + 1) % 3] = 0;
+                pixel[(output_channel + 2) % 3] = 0;
+            }
+        );
+    }
+}
+
+/**
+ * Iterate over every pixel and set selected channels to the maximum value of that pixel.
+ * 
+ * @param src: Source image in RGB color space
+ * @param dst: Output image (will be overwritten)
+ * @param output_channel: wether to choose channel 0, 1, 2 or all (-1)
+*/
+void legacySetChannelsToMax(const cv::Mat& src, cv::Mat& dst, const image_proc::ChannelOption& output_channel) {
+    src.copyTo(dst);
+
+    if (output_channel == image_proc::ChannelOption::ALL) {
+        dst.forEach<image_proc::Pixel>(
+            [](image_proc::Pixel& pixel, const int*) -> void {
+                uint8_t max = std::max(pixel[0], pixel[1]);
+                max = std::max(max, pixel[2]);
+
+                pixel[0] = max; pixel[1] = max; pixel[2] = max;
+            }
+        );
+    } else {
+        dst.forEach<image_proc::Pixel>(
+            [output_channel](image_proc::Pixel& pixel, const int*) -> void {
+                uint8_t max = std::max(pixel[0], pixel[1]);
+                max = std::max(max, pixel[2]);
+
+                pixel[output_channel] = max;
+                pixel[(output_channel + 1) % 3] = 0;
+                pixel[(output_channel + 2) % 3] = 0;
+            }
+        );
+    }
+}
+
+/**
+ * The split/merge manipulateChannels used before it switched to specialized kernels.
+*/
+void legacyManipulateChannels(const cv::Mat& src, cv::Mat& dst, const image_proc::ModifierOption& modifier, const image_proc::ChannelOption& channel) {
+    int output_channel = channel;
+
+    cv::Mat temp;
+    int input_channel;
+    switch (modifier) {
+        case image_proc::ModifierOption::MIN:
+            legacySetChannelsToMin(src, dst, channel);
+            return;
+        case image_proc::ModifierOption::AVG:
+            legacySetChannelsToAvg(src, dst, channel);
+            return;
+        case image_proc::ModifierOption::MAX:
+            legacySetChannelsToMax(src, dst, channel);
+            return;
+        case image_proc::ModifierOption::RED:
+        case image_proc::ModifierOption::GREEN:
+        case image_proc::ModifierOption::BLUE:
+            src.copyTo(temp);
+            input_channel = modifier;
+
+            break;
+        case image_proc::ModifierOption::HUE:
+        case image_proc::ModifierOption::SAT:
+        case image_proc::ModifierOption::VAL:
+            cv::cvtColor(src, temp, cv::COLOR_RGB2HSV_FULL);
+            input_channel = modifier - 3;
+
+            break;
+    }
+
+    std::array<cv::Mat, 3> channels;
+    cv::split(temp, channels);
+
+    cv::Mat output(src.rows, src.cols, CV_8UC3),
+            empty_channel(src.rows, src.cols, CV_8UC1, cv::Scalar(0.0)),
+            selected_channel = channels[input_channel];
+
+    switch (channel) {
+        case image_proc::ChannelOption::ALL:
+            cv::cvtColor(selected_channel, output, cv::COLOR_GRAY2RGB); //pretend to be GRAY
+            break;
+        case image_proc::ChannelOption::R:
+            {
+                std::array<cv::Mat, 3> new_channels = {selected_channel, empty_channel, empty_channel};
+
+                cv::merge(new_channels, output);
+            }
+            break;
+        case image_proc::ChannelOption::G:
+            {
+                std::array<cv::Mat, 3> new_channels = {empty_channel, selected_channel, empty_channel};
+
+                cv::merge(new_channels, output);
+            }
+            break;
+        case image_proc::ChannelOption::B:
+            {
+                std::array<cv::Mat, 3> new_channels = {empty_channel, empty_channel, selected_channel};
+
+                cv::merge(new_channels, output);
+            }
+            break;
+    }
+
+    dst = std::move(output);
+}
+/* #endregion   legacy implementations */
+
+
+/* #region      allocation counting */
+// heap allocations of all threads: malloc and everything built on it (operator new, cv::fastMalloc, ...)
+std::atomic<size_t> nr_heap_allocations {0ul};
+
+#ifdef __GLIBC__
+#define HEAP_ALLOCATIONS_COUNTED
+
+// the definitions of the executable take precedence over the ones of the C library, which still does the work
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+
+    void* malloc(size_t size) {
+        nr_heap_allocations.fetch_add(1ul, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) {
+        nr_heap_allocations.fetch_add(1ul, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size) {
+        nr_heap_allocations.fetch_add(1ul, std::memory_order_relaxed);
+        return __libc_realloc(pointer, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) {
+        nr_heap_allocations.fetch_add(1ul, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) {
+        nr_heap_allocations.fetch_add(1ul, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** pointer, size_t alignment, size_t size) {
+        nr_heap_allocations.fetch_add(1ul, std::memory_order_relaxed);
+        *pointer = __libc_memalign(alignment, size);
+        return *pointer || !size ? 0 : ENOMEM;
+    }
+}
+#endif
+/* #endregion   allocation counting */
+
+
+/* #region      measuring */
+/**
+ * Return a string in lower case, for case insensitive matching.
+ *
+ * @param text: ASCII text
+ * @return lower case copy
+*/
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char character) -> char {return std::tolower(character);});
+
+    return text;
+}
+
+struct Options {
+    std::vector<cv::Size> sizes {{640, 480}, {1920, 1080}, {4000, 3000}, {6000, 4000}, {8660, 5774}};
+    double      min_time        = 0.5;
+    size_t      min_repetitions = 3ul;
+    std::string filter;
+    std::string output_path;
+    bool        legacy          = false;
+};
+
+struct Result {
+    std::string name, variant;
+    cv::Size    size;
+    size_t      repetitions;
+    double      median_seconds, min_seconds;
+    // only set (0/1) if the case compares its output against a reference
+    int         identical = -1;
+    // heap allocations over all measured repetitions (not the warm up), only set where they can be counted
+    long        heap_allocations = -1;
+    // only set if the case counts the buffers its scratch arena allocated (over all repetitions)
+    long        arena_allocations = -1;
+};
+
+class Benchmark {
+    public:
+        Benchmark(const Options& options): options(options) {}
+
+        /**
+         * Measure one case, if it passes the filter.
+         *
+         * @param name: name of the measured entry point
+         * @param variant: parameters of the case
+         * @param size: image size (for the per pixel numbers)
+         * @param function: function to be measured
+         * @return pointer to the stored result (valid until the next run), nullptr if the case got filtered
+        */
+        Result* run(const std::string& name, const std::string& variant, const cv::Size& size, const std::function<void()>& function) {
+            if (!this->options.filter.empty() && toLower(name + '/' + variant).find(toLower(this->options.filter)) == std::string::npos) {
+                return nullptr;
+            }
+
+            // warm up (first touch of the output buffers, cached tables, ...)
+            function();
+
+            std::vector<double> durations;
+            double total = 0.0;
+            size_t allocations = 0ul;
+            while (durations.size() < this->options.min_repetitions || total < this->options.min_time) {
+                // only the allocations of the function itself, not the ones of the bookkeeping around it
+                const size_t allocations_before = nr_heap_allocations.load();
+                const auto start = std::chrono::steady_clock::now();
+                function();
+                const auto end = std::chrono::steady_clock::now();
+                allocations += nr_heap_allocations.load() - allocations_before;
+
+                durations.push_back(std::chrono::duration<double>(end - start).count());
+                total += durations.back();
+            }
+
+            std::sort(durations.begin(), durations.end());
+
+            Result result;
+            result.name             = name;
+            result.variant          = variant;
+            result.size             = size;
+            result.repetitions      = durations.size();
+            result.median_seconds   = durations[durations.size() / 2ul];
+            result.min_seconds      = durations.front();
+#ifdef HEAP_ALLOCATIONS_COUNTED
+            result.heap_allocations = static_cast<long>(allocations);
+#endif
+            this->results.push_back(result);
+
+            std::clog << name << '/' << variant << " @" << size.width << 'x' << size.height << ": "
+                      << result.median_seconds * 1e3 << "ms" << std::endl;
+
+            return &this->results.back();
+        }
+
+        /**
+         * Write all results as JSON.
+         *
+         * @param stream: output stream
+        */
+        void writeJson(std::ostream& stream) const {
+            const std::time_t now = std::time(nullptr);
+            char timestamp[32];
+            std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+            stream << "{\n"
+                   << "  \"timestamp\": \""       << timestamp << "\",\n"
+                   << "  \"opencv_version\": \""  << CV_VERSION << "\",\n"
+                   << "  \"instruction_set\": \"" << image_proc::kernels::instructionSet() << "\",\n"
+                   << "  \"threads\": "           << cv::getNumThreads() << ",\n"
+                   << "  \"results\": [";
+
+            for (size_t i = 0ul; i < this->results.size(); i++) {
+                const Result& result = this->results[i];
+                const double pixels = static_cast<double>(result.size.area());
+
+                stream << (i ? "," : "") << "\n    {"
+                       << "\"name\": \""                << result.name << "\", "
+                       << "\"variant\": \""             << result.variant << "\", "
+                       << "\"width\": "                 << result.size.width << ", "
+                       << "\"height\": "                << result.size.height << ", "
+                       << "\"megapixels\": "            << pixels * 1e-6 << ", "
+                       << "\"repetitions\": "           << result.repetitions << ", "
+                       << "\"median_seconds\": "        << result.median_seconds << ", "
+                       << "\"min_seconds\": "           << result.min_seconds << ", "
+                       << "\"ns_per_pixel\": "          << result.median_seconds * 1e9 / pixels << ", "
+                       << "\"megapixels_per_second\": " << pixels * 1e-6 / result.median_seconds;
+                if (result.identical >= 0) {
+                    stream << ", \"identical\": " << (result.identical ? "true" : "false");
+                }
+                if (result.heap_allocations >= 0) {
+                    stream << ", \"heap_allocations\": " << result.heap_allocations;
+                }
+                if (result.arena_allocations >= 0) {
+                    stream << ", \"arena_allocations\": " << result.arena_allocations;
+                }
+                stream << '}';
+            }
+
+            stream << "\n  ]\n}" << std::endl;
+        }
+    private:
+        const Options& options;
+        std::vector<Result> results;
+};
+/* #endregion   measuring */
+
+
+/**
+ * Parse the command line.
+ *
+ * @param argc: argument count
+ * @param argv: argument values
+ * @param options: output options
+ * @return wether or not the command line is valid
+*/
+bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+
+        if (argument == "-h" || argument == "--help") {
+            std::cout << usage;
+
+            exit(0);
+        } else if (argument == "--legacy") {
+            options.legacy = true;
+
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::cerr << "Unable to parse argument: " << argument << std::endl;
+
+            return false;
+        }
+        const std::string value = argv[++i];
+
+        try {
+            if (argument == "-s" || argument == "--sizes") {
+                options.sizes.clear();
+
+                std::stringstream stream(value);
+                std::string item;
+                while (std::getline(stream, item, ',')) {
+                    const size_t separator = item.find('x');
+                    if (separator == std::string::npos) {
+                        std::cerr << "Sizes need to be given as WxH, got: " << item << std::endl;
+
+                        return false;
+                    }
+
+                    options.sizes.emplace_back(std::stoi(item.substr(0ul, separator)), std::stoi(item.substr(separator + 1ul)));
+                }
+            } else if (argument == "-t" || argument == "--min-time") {
+                options.min_time = std::stod(value);
+            } else if (argument == "-r" || argument == "--min-repetitions") {
+                options.min_repetitions = std::max(std::stoul(value), 1ul);
+            } else if (argument == "-f" || argument == "--filter") {
+                options.filter = value;
+            } else if (argument == "-o" || argument == "--output") {
+                options.output_path = value;
+            } else {
+                std::cerr << "Unable to parse argument: " << argument << std::endl;
+
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Create a synthetic photo-like test image: smooth gradients with some noise, so both the
+ * per pixel kernels and the encoders see realistic data.
+ *
+ * @param size: image size
+ * @return RGB image
+*/
+cv::Mat createSyntheticImage(const cv::Size& size) {
+    cv::Mat image(size, CV_8UC3), noise(size, CV_8UC3);
+
+    image.forEach<image_proc::Pixel>(
+        [&size](image_proc::Pixel& pixel, const int position[2]) -> void {
+            pixel[0] = static_cast<uint8_t>(255 * position[1] / size.width);
+            pixel[1] = static_cast<uint8_t>(255 * position[0] / size.height);
+            pixel[2] = static_cast<uint8_t>((position[0] + position[1]) % 256);
+        }
+    );
+
+    cv::randn(noise, cv::Scalar::all(0.0), cv::Scalar::all(12.0));
+    cv::add(image, noise, image);
+
+    return image;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::cerr << '\n' << usage;
+
+        return 1;
+    }
+
+    // Gtk is only needed for convertCVtoGTK, everything else also runs headless
+    const bool gtk_available = gtk_init_check(nullptr, nullptr);
+    if (gtk_available) {
+        Gtk::Main::init_gtkmm_internals();
+    } else {
+        std::clog << "No display available, skipping convertCVtoGTK." << std::endl;
+    }
+
+    const std::filesystem::path temp_directory = std::filesystem::temp_directory_path() / "bench_image_proc";
+    std::filesystem::create_directories(temp_directory);
+
+    Benchmark benchmark(options);
+    for (const cv::Size& size: options.sizes) {
+        const cv::Mat image = createSyntheticImage(size);
+        cv::Mat output, reference;
+
+        // LIMIT
+        for (size_t i = 0ul; i < image_proc::ColorSpace::LAST; i++) {
+            const image_proc::ColorSpace color_space = static_cast<image_proc::ColorSpace>(i);
+
+            const Result* result = benchmark.run("limitImageByChannels", image_proc::color_space_names[i], size, [&]() {
+                image_proc::limitImageByChannels(image, output, color_space, 40.0, 200.0, 30.0, 220.0, 0.0, 180.0);
+            });
+
+            if (options.legacy && result) {
+                Result* legacy = benchmark.run("legacyLimitImageByChannels", image_proc::color_space_names[i], size, [&]() {
+                    legacyLimitImageByChannels(image, reference, color_space, 40.0, 200.0, 30.0, 220.0, 0.0, 180.0);
+                });
+
+                if (legacy) {
+                    legacy->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+                }
+            }
+        }
+
+        // incremental LIMIT: build once, then move one bound back and forth by a single step
+        {
+            const uint8_t lower[NR_CHANNELS] {40u, 30u, 0u}, upper[NR_CHANNELS] {200u, 220u, 180u};
+            uint8_t moved_lower[NR_CHANNELS] {40u, 30u, 0u};
+            image_proc::LimitIndex limit_index;
+
+            benchmark.run("LimitIndex::build", "", size, [&]() {
+                limit_index = image_proc::LimitIndex();
+                limit_index.build(image, lower, upper);
+            });
+
+            if (!limit_index.isBuiltFor(image)) {
+                limit_index.build(image, lower, upper);
+            }
+            Result* result = benchmark.run("LimitIndex::update", "step", size, [&]() {
+                moved_lower[0] = moved_lower[0] == 40u ? 41u : 40u;
+                limit_index.update(moved_lower, upper);
+            });
+
+            if (result) {
+                image_proc::limitImageByChannels(image, reference, image_proc::ColorSpace::RGB,
+                                                 moved_lower[0], upper[0], moved_lower[1], upper[1], moved_lower[2], upper[2]);
+                result->identical = cv::norm(limit_index.getOutput(), reference, cv::NORM_INF) == 0.0;
+            }
+        }
+
+        // the conversion HUE/SAT/VAL used to need, for comparison with the direct kernels
+        benchmark.run("cvtColor", "RGB2HSV_FULL", size, [&]() {
+            cv::cvtColor(image, output, cv::COLOR_RGB2HSV_FULL);
+        });
+
+        // Channels
+        for (const auto& modifier: modifier_names) {
+            for (const auto& channel: channel_names) {
+                const std::string variant = std::string(modifier.first) + '/' + channel.first;
+
+                Result* result = benchmark.run("manipulateChannels", variant, size, [&]() {
+                    image_proc::manipulateChannels(image, output, modifier.second, channel.second);
+                });
+
+                // the HSV components have to match OpenCV's conversion bit for bit
+                if (result && modifier.second >= image_proc::ModifierOption::HUE && channel.second == image_proc::ChannelOption::ALL) {
+                    cv::Mat hsv, component;
+                    cv::cvtColor(image, hsv, cv::COLOR_RGB2HSV_FULL);
+                    cv::extractChannel(hsv, component, modifier.second - image_proc::ModifierOption::HUE);
+                    cv::cvtColor(component, reference, cv::COLOR_GRAY2RGB);
+
+                    result->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+                }
+
+                if (options.legacy && result) {
+                    Result* legacy = benchmark.run("legacyManipulateChannels", variant, size, [&]() {
+                        legacyManipulateChannels(image, reference, modifier.second, channel.second);
+                    });
+
+                    if (legacy) {
+                        legacy->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+                    }
+                }
+            }
+        }
+
+        // compression
+        for (const double compression_level: compression_levels) {
+            std::stringstream variant;
+            variant << compression_level;
+
+            const Result* result = benchmark.run("compressImage", variant.str(), size, [&]() {
+                image_proc::compressImage(image, output, compression_level);
+            });
+
+            if (options.legacy && result) {
+                Result* legacy = benchmark.run("legacyCompressImage", variant.str(), size, [&]() {
+                    legacyCompressImage(image, reference, compression_level);
+                });
+
+                if (legacy) {
+                    legacy->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+                }
+            }
+        }
+
+        // compiled edits, against applyEdits with the same parameters
+        {
+            image_proc::EditParameters parameters;
+            parameters.color_space = image_proc::ColorSpace::HSV;
+            parameters.limits = {{40.0, 200.0, 30.0, 220.0, 0.0, 180.0}};
+            parameters.compression_level = 4.0;
+
+            for (const size_t lattice_size: {image_proc::EditLut::FULL_LATTICE, 33ul}) {
+                const std::string variant = "lattice " + std::to_string(lattice_size);
+
+                std::unique_ptr<image_proc::EditLut> edit_lut;
+                benchmark.run("EditLut::EditLut", variant, size, [&]() {
+                    edit_lut.reset(new image_proc::EditLut(parameters, lattice_size));
+                });
+                if (!edit_lut) {
+                    edit_lut.reset(new image_proc::EditLut(parameters, lattice_size));
+                }
+
+                Result* result = benchmark.run("EditLut::apply", variant, size, [&]() {
+                    edit_lut->apply(image, output);
+                });
+
+                if (result && lattice_size == image_proc::EditLut::FULL_LATTICE) {
+                    image_proc::applyEdits(image, reference, parameters);
+                    result->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+                }
+            }
+        }
+
+        // palette compaction, on a posterized copy so the image has few distinct colors
+        {
+            cv::Mat posterized;
+            image_proc::compressImage(image, posterized, 3.0);
+
+            image_proc::Palette palette;
+            benchmark.run("Palette::build", "posterized", size, [&]() {
+                palette.build(posterized);
+            });
+            if (!palette.isBuiltFor(posterized)) {
+                palette.build(posterized);
+            }
+
+            if (!palette.empty()) {
+                image_proc::EditParameters parameters;
+                parameters.color_space = image_proc::ColorSpace::HSV;
+                parameters.limits = {{40.0, 200.0, 30.0, 220.0, 0.0, 180.0}};
+
+                Result* result = benchmark.run("Palette::apply", "posterized, edited", size, [&]() {
+                    cv::Mat colors;
+                    image_proc::applyEdits(palette.getColors(), colors, parameters);
+                    palette.apply(colors, output);
+                });
+
+                if (result) {
+                    image_proc::applyEdits(posterized, reference, parameters);
+                    result->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+                }
+            }
+        }
+
+        // statistics, as a separate pass and gathered while rendering
+        benchmark.run("getAverageColorString", "", size, [&]() {
+            image_proc::getAverageColorString(image);
+        });
+        {
+            image_proc::EditParameters parameters;
+            parameters.color_space = image_proc::ColorSpace::HSV;
+            parameters.limits = {{40.0, 200.0, 30.0, 220.0, 0.0, 180.0}};
+            parameters.compression_level = 4.0;
+
+            benchmark.run("applyEdits", "without statistics", size, [&]() {
+                image_proc::applyEdits(image, output, parameters);
+            });
+
+            image_proc::ImageStatistics statistics;
+            Result* result = benchmark.run("applyEdits", "with statistics", size, [&]() {
+                image_proc::applyEdits(image, output, parameters, cv::Mat(), &statistics);
+            });
+
+            if (result) {
+                const cv::Scalar average = cv::mean(output);
+
+                bool identical = statistics.nr_pixels == output.total();
+                for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+                    identical &= std::abs(statistics.mean(channel) - average[channel]) < 1e-6;
+                }
+                result->identical = identical;
+            }
+        }
+
+        // render loop on scratch buffers: one frame displayed while the next one renders, the arena allocates both
+        // during the warm up, the heap allocations show whatever the render path still allocates afterwards
+        {
+            image_proc::EditParameters parameters;
+            parameters.color_space = image_proc::ColorSpace::HSV;
+            parameters.limits = {{40.0, 200.0, 30.0, 220.0, 0.0, 180.0}};
+            parameters.compression_level = 4.0;
+
+            image_proc::ScratchArena scratch_arena;
+            cv::Mat displayed;
+            Result* result = benchmark.run("applyEdits", "scratch arena", size, [&]() {
+                cv::Mat frame = scratch_arena.acquire(image.size(), CV_8UC3);
+                image_proc::applyEdits(image, frame, parameters);
+                displayed = frame;
+            });
+
+            if (result) {
+                result->arena_allocations = static_cast<long>(scratch_arena.getAllocationCount());
+            }
+        }
+
+        // file io
+        for (const std::string extension: {"png", "jpg"}) {
+            const std::string filepath = (temp_directory / ("image." + extension)).string();
+
+            benchmark.run("saveImage", extension, size, [&]() {
+                image_proc::saveImage(image, filepath);
+            });
+            benchmark.run("saveImage", extension + ", bgr", size, [&]() {
+                image_proc::saveImage(image, filepath, image_proc::EncoderSettings(), true);
+            });
+            if (extension == "png") {
+                image_proc::EncoderSettings fastest, smallest;
+                fastest.png_compression  = 1;
+                smallest.png_compression = 9;
+
+                benchmark.run("saveImage", "png, compression 1", size, [&]() {
+                    image_proc::saveImage(image, filepath, fastest);
+                });
+                benchmark.run("saveImage", "png, compression 9", size, [&]() {
+                    image_proc::saveImage(image, filepath, smallest);
+                });
+            }
+            if (std::filesystem::exists(filepath)) {
+                benchmark.run("loadImage", extension, size, [&]() {
+                    image_proc::loadImage(output, filepath);
+                });
+            }
+
+            std::filesystem::remove(filepath);
+        }
+
+        // cached reload: mapping the decoded pixels instead of decoding them
+        {
+            const std::string filepath = (temp_directory / "cached.png").string();
+            image_proc::RawImageCache raw_cache((temp_directory / "raw_cache").string());
+
+            image_proc::EncoderSettings fastest;
+            fastest.png_compression = 0;
+            if (image_proc::saveImage(image, filepath, fastest)) {
+                benchmark.run("RawImageCache::store", "", size, [&]() {
+                    raw_cache.store(image, filepath);
+                });
+                raw_cache.store(image, filepath);
+
+                Result* result = benchmark.run("RawImageCache::load", "", size, [&]() {
+                    raw_cache.load(output, filepath);
+                });
+
+                if (result) {
+                    result->identical = output.size() == image.size() && cv::norm(output, image, cv::NORM_INF) == 0.0;
+                }
+            }
+
+            // the mapping is read-only, later cases write into output
+            output.release();
+            std::filesystem::remove(filepath);
+        }
+
+        // out-of-core: streamed in strips within a quarter of the image size, against editing the whole image
+        {
+            const std::string input_path  = (temp_directory / "stream_input.ppm").string(),
+                              output_path = (temp_directory / "stream_output.ppm").string();
+
+            image_proc::EditParameters parameters;
+            parameters.color_space = image_proc::ColorSpace::HSV;
+            parameters.limits = {{40.0, 200.0, 30.0, 220.0, 0.0, 180.0}};
+            parameters.compression_level = 4.0;
+
+            // small sizes get the smallest budget holding a few rows
+            const size_t row_bytes = image.cols * NR_CHANNELS;
+            const size_t memory_budget = std::max(image.total() * NR_CHANNELS / 4ul,
+                                                  cv::getNumThreads() * std::max(static_cast<size_t>(LIMIT_STRIP_BYTES), row_bytes) + 16ul * row_bytes);
+
+            image_proc::PpmWriter writer;
+            if (writer.open(input_path, image.size()) && writer.write(image) && writer.close()) {
+                image_proc::StreamSummary summary;
+                Result* result = benchmark.run("streamEdits", "quarter budget", size, [&]() {
+                    image_proc::streamEdits(input_path, output_path, parameters, memory_budget, &summary);
+                });
+
+                image_proc::PpmReader reader;
+                if (result && reader.open(output_path) && reader.getSize() == image.size()) {
+                    cv::Mat streamed(image.size(), CV_8UC3);
+                    image_proc::applyEdits(image, reference, parameters);
+
+                    result->identical = reader.read(streamed) == image.rows && summary.buffer_bytes <= memory_budget
+                                     && cv::norm(streamed, reference, cv::NORM_INF) == 0.0;
+                }
+            }
+
+            std::filesystem::remove(input_path);
+            std::filesystem::remove(output_path);
+        }
+
+        // tiled: time to the visible tiles of a screen sized viewport, and the complete image tile by tile
+        {
+            image_proc::EditParameters parameters;
+            parameters.color_space = image_proc::ColorSpace::HSV;
+            parameters.limits = {{40.0, 200.0, 30.0, 220.0, 0.0, 180.0}};
+            parameters.compression_level = 4.0;
+
+            const cv::Rect viewport = cv::Rect((image.cols - 1920) / 2, (image.rows - 1080) / 2, 1920, 1080) & cv::Rect(cv::Point(), image.size());
+
+            // a new renderer per run, so no tile comes from the cache
+            cv::Mat region_image;
+            benchmark.run("TileRenderer::renderVisible", "1920x1080 viewport", size, [&]() {
+                image_proc::TileRenderer tile_renderer;
+                tile_renderer.renderVisible(image, cv::Mat(), parameters, viewport, region_image);
+            });
+
+            image_proc::ImageStatistics statistics;
+            Result* result = benchmark.run("TileRenderer::renderAll", "1920x1080 viewport", size, [&]() {
+                image_proc::TileRenderer tile_renderer;
+                tile_renderer.renderAll(image, cv::Mat(), parameters, viewport, output, statistics, nullptr);
+            });
+
+            if (result) {
+                image_proc::applyEdits(image, reference, parameters);
+                result->identical = cv::norm(output, reference, cv::NORM_INF) == 0.0;
+            }
+        }
+
+        // display
+        if (gtk_available) {
+            Gtk::Image gtk_image;
+
+            benchmark.run("convertCVtoGTK", "", size, [&]() {
+                image_proc::convertCVtoGTK(image, gtk_image);
+            });
+        }
+    }
+
+    std::filesystem::remove_all(temp_directory);
+
+    if (options.output_path.empty()) {
+        benchmark.writeJson(std::cout);
+    } else {
+        std::ofstream file(options.output_path);
+        if (!file) {
+            std::cerr << "Unable to open " << options.output_path << std::endl;
+
+            return 1;
+        }
+
+        benchmark.writeJson(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <opencv2/imgproc.hpp>
+
+#include "conversion_cache.hpp"
+#include "tracer.hpp"
+
+
+image_proc::ConversionCache::ConversionCache(size_t memory_budget):
+    memory_budget(memory_budget),
+    thread(&ConversionCache::work, this) {}
+
+image_proc::ConversionCache::~ConversionCache() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_all();
+    this->thread.join();
+}
+
+void image_proc::ConversionCache::setSource(const cv::Mat& source) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+
+        this->source = source;
+        this->source_version++;
+
+        // conversions still running for the old source get discarded when they finish
+        for (size_t i = 0ul; i < ColorSpace::LAST; i++) {
+            this->converted[i].release();
+            this->converting[i] = false;
+        }
+        this->prefetch_queue.clear();
+    }
+
+    this->condition.notify_all();
+}
+
+cv::Mat image_proc::ConversionCache::get(const cv::Mat& source, const ColorSpace& color_space) {
+    if (color_space == ColorSpace::RGB) {
+        return source;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    // not (or no longer) the cached source
+    if (source.data != this->source.data || source.size() != this->source.size()) {
+        lock.unlock();
+
+        cv::Mat result;
+        {
+            TRACE_SCOPE("cvtColor");
+            cv::cvtColor(source, result, image_proc::convert_from_rgb[color_space]);
+        }
+
+        return result;
+    }
+
+    this->active = color_space;
+
+    while (true) {
+        if (!this->converted[color_space].empty()) {
+            this->last_used[color_space] = ++this->use_counter;
+
+            return this->converted[color_space];
+        }
+
+        if (!this->converting[color_space]) {
+            break;
+        }
+
+        // being converted in the background
+        this->condition.wait(lock);
+    }
+
+    this->converting[color_space] = true;
+    const uint64_t version = this->source_version;
+
+    lock.unlock();
+    cv::Mat result;
+    {
+        TRACE_SCOPE("cvtColor");
+        cv::cvtColor(source, result, image_proc::convert_from_rgb[color_space]);
+    }
+    lock.lock();
+
+    if (version == this->source_version) {
+        this->store(color_space, result);
+    }
+
+    return result;
+}
+
+cv::Mat image_proc::ConversionCache::tryGet(const cv::Mat& source, const ColorSpace& color_space) {
+    if (color_space == ColorSpace::RGB) {
+        return source;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    if (source.data != this->source.data || source.size() != this->source.size()) {
+        return cv::Mat();
+    }
+
+    this->active = color_space;
+    if (this->converted[color_space].empty()) {
+        return cv::Mat();
+    }
+
+    this->last_used[color_space] = ++this->use_counter;
+
+    return this->converted[color_space];
+}
+
+void image_proc::ConversionCache::prefetch(const ColorSpace& color_space) {
+    if (color_space == ColorSpace::RGB) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->prefetch_queue.push_back(color_space);
+    }
+
+    this->condition.notify_all();
+}
+
+void image_proc::ConversionCache::work() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (true) {
+        this->condition.wait(lock, [this]() {return this->stopping || !this->prefetch_queue.empty();});
+
+        if (this->stopping) {
+            return;
+        }
+
+        const ColorSpace color_space = this->prefetch_queue.front();
+        this->prefetch_queue.pop_front();
+
+        if (this->source.empty() || !this->converted[color_space].empty() || this->converting[color_space]) {
+            continue;
+        }
+
+        this->converting[color_space] = true;
+        const cv::Mat source = this->source;
+        const uint64_t version = this->source_version;
+
+        lock.unlock();
+        cv::Mat result;
+        {
+            TRACE_SCOPE("cvtColor");
+            cv::cvtColor(source, result, image_proc::convert_from_rgb[color_space]);
+        }
+        lock.lock();
+
+        if (version == this->source_version) {
+            this->store(color_space, result);
+        }
+    }
+}
+
+void image_proc::ConversionCache::store(const ColorSpace& color_space, const cv::Mat& converted) {
+    this->converted[color_space]  = converted;
+    this->converting[color_space] = false;
+    this->last_used[color_space]  = ++this->use_counter;
+
+    // the color space in use does not count against the budget, a prefetched one is just the most recent candidate
+    const size_t active = this->active;
+    size_t used_memory = 0ul;
+    for (size_t i = 0ul; i < ColorSpace::LAST; i++) {
+        if (i != active && !this->converted[i].empty()) {
+            used_memory += this->converted[i].total() * this->converted[i].elemSize();
+        }
+    }
+
+    while (used_memory > this->memory_budget) {
+        size_t oldest = active;
+        for (size_t i = 0ul; i < ColorSpace::LAST; i++) {
+            if (i != active && !this->converted[i].empty() && (oldest == active || this->last_used[i] < this->last_used[oldest])) {
+                oldest = i;
+            }
+        }
+
+        used_memory -= this->converted[oldest].total() * this->converted[oldest].elemSize();
+        this->converted[oldest].release();
+    }
+
+    this->condition.notify_all();
+}
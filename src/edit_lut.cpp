@@ -0,0 +1,119 @@
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+
+#include "edit_lut.hpp"
+#include "kernels.hpp"
+#include "tracer.hpp"
+
+
+#define MAX_8BIT 0xFF
+
+
+image_proc::EditLut::EditLut(const EditParameters& parameters, size_t lattice_size, bool bgr):
+    lattice_size(std::min(std::max(lattice_size, 2ul), FULL_LATTICE)) {
+
+    const size_t size = this->lattice_size;
+    std::vector<uint8_t> values(size);
+    for (size_t i = 0ul; i < size; i++) {
+        values[i] = cvRound(i * static_cast<double>(MAX_8BIT) / (size - 1ul));
+    }
+
+    if (size == FULL_LATTICE) {
+        this->table.resize(size * size * size);
+    } else {
+        this->lattice.resize(size * size * size * NR_CHANNELS);
+    }
+
+    // channel order of the input and output pixels, the edit itself always sees RGB
+    const size_t red = bgr ? 2ul : 0ul, blue = bgr ? 0ul : 2ul;
+
+    // one plane of (second, third channel) samples per first channel sample, edited like any other image
+    cv::parallel_for_(cv::Range(0, static_cast<int>(size)), [&](const cv::Range& range) -> void {
+        cv::Mat plane(static_cast<int>(size), static_cast<int>(size), CV_8UC3), edited;
+
+        for (int c0 = range.start; c0 < range.end; c0++) {
+            for (size_t c1 = 0ul; c1 < size; c1++) {
+                uint8_t* pixel = plane.ptr<uint8_t>(c1);
+
+                for (size_t c2 = 0ul; c2 < size; c2++, pixel += NR_CHANNELS) {
+                    pixel[red] = values[c0]; pixel[1] = values[c1]; pixel[blue] = values[c2];
+                }
+            }
+
+            image_proc::applyEdits(plane, edited, parameters);
+
+            for (size_t c1 = 0ul; c1 < size; c1++) {
+                const uint8_t* pixel = edited.ptr<uint8_t>(c1);
+                const size_t offset = (c0 * size + c1) * size;
+
+                for (size_t c2 = 0ul; c2 < size; c2++, pixel += NR_CHANNELS) {
+                    if (size == FULL_LATTICE) {
+                        this->table[offset + c2] = pixel[red] | (pixel[1] << 8) | (pixel[blue] << 16);
+                    } else {
+                        uint8_t* sample = this->lattice.data() + (offset + c2) * NR_CHANNELS;
+                        sample[0] = pixel[red]; sample[1] = pixel[1]; sample[2] = pixel[blue];
+                    }
+                }
+            }
+        }
+    });
+}
+
+void image_proc::EditLut::apply(const cv::Mat& src, cv::Mat& dst) const {
+    TRACE_SCOPE("EditLut::apply");
+
+    assert(src.type() == CV_8UC3);
+
+    // same size and type for in place use, so create keeps the data
+    dst.create(src.size(), CV_8UC3);
+
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range) -> void {
+        for (int y = range.start; y < range.end; y++) {
+            if (this->lattice_size == FULL_LATTICE) {
+                image_proc::kernels::lookup3DRow(src.ptr<uint8_t>(y), dst.ptr<uint8_t>(y), src.cols, this->table.data());
+            } else {
+                this->interpolateRow(src.ptr<uint8_t>(y), dst.ptr<uint8_t>(y), src.cols);
+            }
+        }
+    });
+}
+
+void image_proc::EditLut::interpolateRow(const uint8_t* src, uint8_t* dst, size_t width) const {
+    const size_t size = this->lattice_size, last = size - 1ul;
+    const size_t stride_b = NR_CHANNELS, stride_g = size * stride_b, stride_r = size * stride_g;
+
+    // weights are fractions of MAX_8BIT, so three interpolation steps stay within 32bit
+    const uint32_t scale = MAX_8BIT * MAX_8BIT * MAX_8BIT;
+
+    for (size_t x = 0ul; x < width; x++, src += NR_CHANNELS, dst += NR_CHANNELS) {
+        size_t   cell[NR_CHANNELS];
+        uint32_t weight[NR_CHANNELS];
+
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            const uint32_t position = src[channel] * last;
+            cell[channel]   = position / MAX_8BIT;
+            weight[channel] = position % MAX_8BIT;
+
+            // the maximum lies on the last sample, interpolate towards it from the cell before
+            if (cell[channel] == last) {
+                cell[channel]   = last - 1ul;
+                weight[channel] = MAX_8BIT;
+            }
+        }
+
+        const uint8_t* corner = this->lattice.data() + cell[0] * stride_r + cell[1] * stride_g + cell[2] * stride_b;
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++, corner++) {
+            const auto lerp = [](uint32_t a, uint32_t b, uint32_t weight) -> uint32_t {
+                return a * (MAX_8BIT - weight) + b * weight;
+            };
+
+            const uint32_t r0 = lerp(lerp(corner[0],                   corner[stride_b],                       weight[2]),
+                                     lerp(corner[stride_g],            corner[stride_g + stride_b],            weight[2]), weight[1]),
+                           r1 = lerp(lerp(corner[stride_r],            corner[stride_r + stride_b],            weight[2]),
+                                     lerp(corner[stride_r + stride_g], corner[stride_r + stride_g + stride_b], weight[2]), weight[1]);
+
+            dst[channel] = (lerp(r0, r1, weight[0]) + scale / 2u) / scale;
+        }
+    }
+}
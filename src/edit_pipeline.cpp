@@ -0,0 +1,235 @@
+#include <opencv2/core.hpp>
+
+#include <iostream>
+
+#include "edit_pipeline.hpp"
+#include "tracer.hpp"
+
+
+image_proc::EditPipeline::EditPipeline(ConversionCache* conversion_cache, ScratchArena* scratch_arena, bool incremental):
+    conversion_cache(conversion_cache),
+    scratch_arena(scratch_arena),
+    incremental(incremental) {}
+
+void image_proc::EditPipeline::render(const cv::Mat& source, const EditParameters& parameters, cv::Mat& image, ImageStatistics& statistics) {
+    TRACE_SCOPE("EditPipeline::render");
+
+    this->nr_stages_run = 0ul;
+    this->setSource(source);
+
+    // few colors: every stage but the final gather works on the palette instead of the pixels
+    const cv::Mat& pixels = this->palette.empty() ? this->source : this->palette.getColors();
+
+    Branch& branch = this->branches[parameters.mode];
+    uint64_t edit_input_version = this->source_version;
+
+    if (parameters.mode == EditMode::LIMIT) {
+        this->convert(parameters.color_space);
+        edit_input_version = this->conversion_stage.version;
+    }
+
+    const EditKey edit_key = getEditKey(parameters);
+    if (!branch.edit_stage.isCurrent(edit_key, edit_input_version)) {
+        this->edit(branch, parameters, pixels, this->converted);
+        this->ran(branch.edit_stage, edit_key, edit_input_version);
+    }
+
+    if (!branch.compression_stage.isCurrent(parameters.compression_level, branch.edit_stage.version)) {
+        this->compress(branch, parameters.compression_level);
+        this->ran(branch.compression_stage, parameters.compression_level, branch.edit_stage.version);
+    }
+
+    // the histograms of the edit only get remapped, no pass over the pixels
+    if (!branch.statistics_stage.isCurrent(parameters.compression_level, branch.edit_stage.version)) {
+        TRACE_SCOPE("EditPipeline::statistics");
+        branch.statistics = branch.edited_statistics;
+        if (parameters.compression_level != 8.0) {
+            branch.statistics.compress(image_proc::getCompressionTable(parameters.compression_level));
+        }
+        this->ran(branch.statistics_stage, parameters.compression_level, branch.edit_stage.version);
+    }
+
+    image      = branch.output;
+    statistics = branch.statistics;
+}
+
+bool image_proc::EditPipeline::isWarm(const cv::Mat& source, const EditParameters& parameters) const {
+    if (source.data != this->source.data || source.size() != this->source.size()) {
+        return false;
+    }
+
+    // palette colors are edited instead of pixels, every stage is cheap
+    if (!this->palette.empty()) {
+        return true;
+    }
+
+    uint64_t edit_input_version = this->source_version;
+    if (parameters.mode == EditMode::LIMIT) {
+        if (!this->conversion_stage.isCurrent(parameters.color_space, this->source_version)) {
+            return false;
+        }
+
+        // the limit index only updates the pixels whose state changes
+        if (this->incremental && this->limit_index.isBuiltFor(this->converted)) {
+            return true;
+        }
+
+        edit_input_version = this->conversion_stage.version;
+    }
+
+    return this->branches[parameters.mode].edit_stage.isCurrent(getEditKey(parameters), edit_input_version);
+}
+
+void image_proc::EditPipeline::warmUp(const cv::Mat& source, const EditParameters& parameters, const std::function<bool()>& cancelled) {
+    TRACE_SCOPE("EditPipeline::warmUp");
+
+    if (cancelled()) {
+        return;
+    }
+    this->setSource(source);
+
+    if (!this->incremental || !this->palette.empty() || parameters.mode != EditMode::LIMIT || cancelled()) {
+        return;
+    }
+    this->convert(parameters.color_space);
+
+    if (cancelled() || !this->converted.isContinuous() || this->limit_index.isBuiltFor(this->converted)) {
+        return;
+    }
+
+    uint8_t lower[NR_CHANNELS], upper[NR_CHANNELS];
+    for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+        lower[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul]);
+        upper[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul + 1ul]);
+    }
+
+    // the next render of the edit stage only updates the index
+    this->limit_index.build(this->converted, lower, upper);
+}
+
+void image_proc::EditPipeline::setSource(const cv::Mat& source) {
+    // everything below the source belongs to the old image, its buffers are released right away
+    if (source.data == this->source.data && source.size() == this->source.size()) {
+        return;
+    }
+
+    this->source = source;
+    this->source_version = ++this->version_counter;
+    this->nr_stages_run++;
+
+    this->conversion_stage = Stage<ColorSpace>();
+    this->converted.release();
+    this->branches = std::array<Branch, 2>();
+
+    if (this->incremental) {
+        this->buildPalette();
+    }
+}
+
+void image_proc::EditPipeline::convert(ColorSpace color_space) {
+    if (this->conversion_stage.isCurrent(color_space, this->source_version)) {
+        return;
+    }
+
+    TRACE_SCOPE("EditPipeline::convert");
+
+    // few colors: only the palette colors get converted
+    const cv::Mat& pixels = this->palette.empty() ? this->source : this->palette.getColors();
+    this->converted = this->conversion_cache->get(pixels, color_space);
+    this->ran(this->conversion_stage, color_space, this->source_version);
+}
+
+image_proc::EditPipeline::EditKey image_proc::EditPipeline::getEditKey(const EditParameters& parameters) {
+    EditKey edit_key {};
+    if (parameters.mode == EditMode::LIMIT) {
+        // the bounds are applied as 8bit values, fractions in between do not change the result
+        for (size_t i = 0ul; i < 2ul * NR_CHANNELS; i++) {
+            edit_key[i] = cv::saturate_cast<uint8_t>(parameters.limits[i]);
+        }
+    } else {
+        edit_key[0] = parameters.modifier;
+        edit_key[1] = parameters.channel;
+    }
+
+    return edit_key;
+}
+
+void image_proc::EditPipeline::edit(Branch& branch, const EditParameters& parameters, const cv::Mat& pixels, const cv::Mat& converted) {
+    TRACE_SCOPE("EditPipeline::edit");
+
+    EditParameters uncompressed = parameters;
+    uncompressed.compression_level = 8.0;
+    branch.edited_volatile = false;
+
+    if (!this->palette.empty()) {
+        // edit every distinct color once, the output stage gathers them
+        image_proc::applyEdits(pixels, branch.edited, uncompressed, converted);
+
+        if (parameters.mode != EditMode::LIMIT) {
+            this->palette.getStatistics(branch.edited, branch.edited_statistics);
+            return;
+        }
+
+        // the in range test only needs the (few) source colors in the limiting color space
+        cv::Scalar lower, upper;
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            lower[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul]);
+            upper[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul + 1ul]);
+        }
+
+        cv::Mat in_range;
+        cv::inRange(converted, lower, upper, in_range);
+        this->palette.getStatistics(branch.edited, branch.edited_statistics, in_range);
+    } else if (parameters.mode == EditMode::LIMIT && this->incremental && converted.isContinuous()) {
+        uint8_t lower[NR_CHANNELS], upper[NR_CHANNELS];
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            lower[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul]);
+            upper[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul + 1ul]);
+        }
+
+        // the index is rebuilt only for a new image or color space, slider moves just update it
+        if (this->limit_index.isBuiltFor(converted)) {
+            this->limit_index.update(lower, upper);
+        } else {
+            this->limit_index.build(converted, lower, upper);
+        }
+
+        branch.edited = this->limit_index.getOutput();
+        branch.edited_volatile = true;
+        branch.edited_statistics = this->limit_index.getStatistics();
+    } else {
+        // the old buffer goes back to the arena, unless the output still shares it
+        branch.edited.release();
+        branch.edited = this->scratch_arena->acquire(pixels.size(), CV_8UC3);
+
+        image_proc::applyEdits(pixels, branch.edited, uncompressed, converted, &branch.edited_statistics);
+    }
+}
+
+void image_proc::EditPipeline::compress(Branch& branch, double compression_level) {
+    TRACE_SCOPE("EditPipeline::compress");
+
+    // the previous output may still be displayed, it is never written to again
+    branch.output.release();
+
+    if (!this->palette.empty()) {
+        image_proc::compressImage(branch.edited, branch.compressed_colors, compression_level);
+
+        branch.output = this->scratch_arena->acquire(this->source.size(), CV_8UC3);
+        this->palette.apply(branch.compressed_colors, branch.output);
+    } else if (compression_level == 8.0 && !branch.edited_volatile) {
+        branch.output = branch.edited;
+    } else {
+        branch.output = this->scratch_arena->acquire(branch.edited.size(), CV_8UC3);
+        image_proc::compressImage(branch.edited, branch.output, compression_level);
+    }
+}
+
+void image_proc::EditPipeline::buildPalette() {
+    if (this->palette.build(this->source)) {
+        std::clog << "Palette: " << this->palette.getColors().total() << " colors for " << this->source.total() << " pixels ("
+                  << this->palette.getCompactionRatio() << "x compaction), editing per color" << std::endl;
+    } else {
+        std::clog << "Palette: too many colors for " << this->source.total() << " pixels, editing per pixel" << std::endl;
+    }
+}
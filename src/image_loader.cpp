@@ -0,0 +1,133 @@
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+#include "image_loader.hpp"
+#include "image_proc.hpp"
+
+
+/**
+ * Check wether a file is a JPEG by its extension, only those can be decoded at reduced resolution cheaply.
+ *
+ * @param filepath: path to the image
+ * @return wether or not the file is a JPEG
+*/
+bool isJpeg(const std::string& filepath) {
+    std::string extension = std::filesystem::path(filepath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {return std::tolower(c);});
+
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".jpe";
+}
+
+
+ImageLoader::ImageLoader():
+    thread(&ImageLoader::work, this) {}
+
+ImageLoader::~ImageLoader() {
+    {
+        std::lock_guard<std::mutex> lock(this->request_mutex);
+        this->stopping = true;
+    }
+    this->newest_generation++;
+    this->request_condition.notify_one();
+    this->thread.join();
+
+    delete this->finished_result.exchange(nullptr);
+}
+
+uint64_t ImageLoader::load(const std::string& filepath) {
+    uint64_t generation;
+
+    {
+        std::lock_guard<std::mutex> lock(this->request_mutex);
+
+        // a load that did not start yet is simply replaced, a running one notices the new generation
+        this->pending_filepath = filepath;
+        generation = this->pending_generation = ++this->newest_generation;
+    }
+    this->request_condition.notify_one();
+
+    return generation;
+}
+
+std::unique_ptr<ImageLoader::Result> ImageLoader::takeResult() {
+    std::unique_ptr<Result> result(this->finished_result.exchange(nullptr));
+
+    if (result && this->cancelled(result->generation)) {
+        return nullptr;
+    }
+
+    return result;
+}
+
+void ImageLoader::work() {
+    while (true) {
+        std::string filepath;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(this->request_mutex);
+            this->request_condition.wait(lock, [this]() {return this->stopping || !this->pending_filepath.empty();});
+
+            if (this->stopping) {
+                return;
+            }
+
+            filepath   = std::move(this->pending_filepath);
+            generation = this->pending_generation;
+            this->pending_filepath.clear();
+        }
+
+        // decoded before: no first paint needed, mapping is instant
+        std::unique_ptr<Result> cached(new Result {generation, filepath, Stage::FULL, cv::Mat()});
+        if (this->raw_cache.load(cached->image, filepath)) {
+            this->publish(std::move(cached));
+
+            continue;
+        }
+
+        // first paint: libjpeg decodes at 1/4 or 1/8 scale in a fraction of the time
+        if (isJpeg(filepath)) {
+            std::error_code error;
+            const uintmax_t file_size = std::filesystem::file_size(filepath, error);
+            const int flags = !error && file_size > LOAD_PREVIEW_EIGHTH_BYTES ? cv::IMREAD_REDUCED_COLOR_8 : cv::IMREAD_REDUCED_COLOR_4;
+
+            std::unique_ptr<Result> preview(new Result {generation, filepath, Stage::PREVIEW, cv::Mat()});
+            if (image_proc::loadImage(preview->image, filepath, flags) && !this->publish(std::move(preview))) {
+                continue;
+            }
+        }
+
+        if (this->cancelled(generation)) {
+            continue;
+        }
+
+        std::unique_ptr<Result> result(new Result {generation, filepath, Stage::FULL, cv::Mat()});
+        if (!image_proc::loadImage(result->image, filepath)) {
+            result->stage = Stage::FAILED;
+        }
+
+        // written after handing the image over, it is only needed for the next time
+        const cv::Mat image = result->image;
+        if (this->publish(std::move(result)) && image.total() >= RAW_CACHE_MIN_PIXELS) {
+            this->raw_cache.store(image, filepath);
+        }
+    }
+}
+
+bool ImageLoader::publish(std::unique_ptr<Result> result) {
+    if (this->cancelled(result->generation)) {
+        return false;
+    }
+
+    // a result the main loop did not take yet is outdated now
+    delete this->finished_result.exchange(result.release());
+    this->result_ready.emit();
+
+    return true;
+}
+
+bool ImageLoader::cancelled(uint64_t generation) const {
+    return generation != this->newest_generation.load();
+}
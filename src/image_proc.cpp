@@ -1,228 +1,334 @@
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
 
 #include "image_proc.hpp"
+#include "kernels.hpp"
+#include "tracer.hpp"
 
 #define MAX_8BIT 0xFF
 
+// neutral values of the channels a limit preview does not show, as a fraction of the 8bit range
+// (not the best solution for HSV/HLS, but better than getting too complex)
+const std::array<const std::array<const double, NR_CHANNELS>, image_proc::ColorSpace::LAST> limit_preview_base_layouts {{
+    {{0.0, 0.0, 0.0}},
+    {{0.0, 0.0, 0.0}},          {{0.0, 0.0, 0.0}},          {{0.5, 0.5, 0.5}},          {{0.5, 0.5, 0.5}},
+    {{0.5, 0.5, 0.5}},          {{0.5, 0.5, 0.5}},          {{0.5, 0.5, 0.5}},          {{0.5, 0.5, 0.5}},
+}};
 
-void image_proc::limitImageByChannels(const cv::Mat& src, cv::Mat& dst, const ColorSpace& color_space,
-                                      const double bottom0, const double top0, const double bottom1, const double top1, const double bottom2, const double top2) {
-    const cv::Scalar lower_boundary(bottom0, bottom1, bottom2),
-                     upper_boundary(top0,    top1,    top2);
-
-    // make a mask for the areas which are within the given ranges
-    cv::Mat mask, temp;
-    if (color_space) { // color_space 0 is RGB, so it does not need to be converted
-        cv::cvtColor(src, temp, image_proc::convert_from_rgb[color_space]);
-        cv::inRange(temp, lower_boundary, upper_boundary, mask);
-    } else {
-        cv::copyTo(src, temp, cv::noArray());
-        cv::inRange(temp, lower_boundary, upper_boundary, mask);
-    }
 
-    // create gray 3-channel background image
-    cv::Mat gray, foreground, background;
-    cv::cvtColor(temp, gray, cv::COLOR_RGB2GRAY);
-    cv::cvtColor(gray, gray, cv::COLOR_GRAY2RGB);
-
-    // mask the gray background with the colorful original image
-    std::cout << mask.size() << temp.size() << cv::typeToString(mask.type()) << std::endl;
-    cv::bitwise_or(temp, temp, foreground, mask);
-    cv::bitwise_not(mask, mask);
-    cv::bitwise_or(gray, gray, background, mask);
-    cv::bitwise_or(foreground, background, dst);
-}
+/**
+ * Format an average color, shared by both getAverageColorString variants so they always agree.
+ *
+ * @param red: mean of the red channel
+ * @param green: mean of the green channel
+ * @param blue: mean of the blue channel
+ * @return formatted mean string
+*/
+std::string formatAverageColor(double red, double green, double blue) {
+    std::stringstream avg_color_string;
 
+    avg_color_string << std::fixed << std::setfill('0') << std::setprecision(2)
+                     <<   "R: " << red
+                     << "\tG: " << green
+                     << "\tB: " << blue;
+
+    return avg_color_string.str();
+}
 
 /**
- * Iterate over every pixel and set selected channels to the minimum value of that pixel.
- * 
- * @param src: Source image in RGB color space
- * @param dst: Output image (will be overwritten)
- * @param output_channel: wether to choose channel 0, 1, 2 or all (-1)
+ * Per thread part of the statistics gathered while rows are written.
 */
-void setChannelsToMin(const cv::Mat& src, cv::Mat& dst, const image_proc::ChannelOption& output_channel) {
-    src.copyTo(dst);
+struct RowStatistics {
+    size_t nr_pixels   = 0ul;
+    size_t nr_in_range = 0ul;
+    std::array<uint32_t, NR_CHANNELS * 256ul> histograms {};
+
+    /**
+     * Add this part to the statistics of the whole image.
+     *
+     * @param statistics: statistics of the whole image
+     * @param mutex: mutex guarding statistics
+    */
+    void addTo(image_proc::ImageStatistics& statistics, std::mutex& mutex) const {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        statistics.nr_pixels   += this->nr_pixels;
+        statistics.nr_in_range += this->nr_in_range;
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            for (size_t value = 0ul; value < 256ul; value++) {
+                statistics.histograms[channel][value] += this->histograms[channel * 256ul + value];
+            }
+        }
+    }
+};
 
-    if (output_channel == image_proc::ChannelOption::ALL) {
-        dst.forEach<image_proc::Pixel>(
-            [](image_proc::Pixel& pixel, const int*) -> void {
-                uint8_t min = std::min(pixel[0], pixel[1]);
-                min = std::min(min, pixel[2]);
+/**
+ * Compress a freshly written row in place and add it to the statistics, while it is still in cache.
+ *
+ * @param row: the written row
+ * @param width: number of pixels in the row
+ * @param compression_table: table of compressImage, empty for no compression
+ * @param statistics: statistics to add the row to, nullptr for none
+*/
+void finishRow(uint8_t* row, int width, const cv::Mat& compression_table, RowStatistics* statistics) {
+    if (!compression_table.empty()) {
+        cv::Mat row_header(1, width, CV_8UC3, row);
+        cv::LUT(row_header, compression_table, row_header);
+    }
 
-                pixel[0] = min; pixel[1] = min; pixel[2] = min;
-            }
-        );
-    } else {
-        dst.forEach<image_proc::Pixel>(
-            [output_channel](image_proc::Pixel& pixel, const int*) -> void {
-                uint8_t min = std::min(pixel[0], pixel[1]);
-                min = std::min(min, pixel[2]);
-
-                pixel[output_channel] = min;
-                pixel[(output_channel + 1) % 3] = 0;
-                pixel[(output_channel + 2) % 3] = 0;
-            }
-        );
+    if (statistics) {
+        statistics->nr_pixels += width;
+        image_proc::kernels::histogramRow(row, width, statistics->histograms.data());
     }
 }
 
 /**
- * Iterate over every pixel and set selected channels to average of all values of that pixel.
- * 
- * @param src: Source image in RGB color space
- * @param dst: Output image (will be overwritten)
- * @param output_channel: wether to choose channel 0, 1, 2 or all (-1)
+ * Limit, compress and gather statistics in one pass (see limitImageByChannels).
+ *
+ * @param src: original source image in RGB
+ * @param dst: output image (will be overwritten)
+ * @param color_space: the color space to be used for restriction
+ * @param lower: lower bounds per channel
+ * @param upper: upper bounds per channel
+ * @param compression_table: table of compressImage, empty for no compression
+ * @param statistics: statistics of dst (will be overwritten), nullptr for none
 */
-void setChannelsToAvg(const cv::Mat& src, cv::Mat& dst, const image_proc::ChannelOption& output_channel) {
-    src.copyTo(dst);
-
-    if (output_channel == image_proc::ChannelOption::ALL) {
-        dst.forEach<image_proc::Pixel>(
-            [](image_proc::Pixel& pixel, const int*) -> void {
-                uint8_t avg = (pixel[0] + pixel[1] + pixel[2]) / 3u;
+void limitImage(const cv::Mat& src, cv::Mat& dst, const image_proc::ColorSpace& color_space, const uint8_t* lower, const uint8_t* upper,
+                const cv::Mat& compression_table, image_proc::ImageStatistics* statistics) {
+    assert(src.type() == CV_8UC3);
 
-                pixel[0] = avg; pixel[1] = avg; pixel[2] = avg;
+    dst.create(src.size(), CV_8UC3);
+    if (statistics) {
+        *statistics = image_proc::ImageStatistics();
+    }
+    std::mutex statistics_mutex;
+
+    // convert, test and composite strip wise so the converted pixels are still in cache when they get composited
+    const int strip_height = std::max(1, LIMIT_STRIP_BYTES / static_cast<int>(src.cols * NR_CHANNELS));
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range) -> void {
+        // strip buffer per thread, kept across calls so repeated renders of one image do not allocate
+        thread_local cv::Mat strip_buffer;
+        cv::Mat converted;
+        RowStatistics row_statistics;
+
+        for (int strip_start = range.start; strip_start < range.end; strip_start += strip_height) {
+            const int strip_end = std::min(strip_start + strip_height, range.end);
+
+            const cv::Mat src_strip = src.rowRange(strip_start, strip_end);
+            if (color_space) { // color_space 0 is RGB, so it does not need to be converted
+                if (strip_buffer.rows < strip_height || strip_buffer.cols != src.cols) {
+                    strip_buffer.create(strip_height, src.cols, CV_8UC3);
+                }
+
+                // a header of matching size and type, so cvtColor writes into the buffer
+                converted = strip_buffer.rowRange(0, strip_end - strip_start);
+                cv::cvtColor(src_strip, converted, image_proc::convert_from_rgb[color_space]);
+            } else {
+                converted = src_strip;
             }
-        );
-    } else {
-        dst.forEach<image_proc::Pixel>(
-            [output_channel](image_proc::Pixel& pixel, const int*) -> void {
-                uint8_t avg = (pixel[0] + pixel[1] + pixel[2]) / 3u;
 
-                pixel[output_channel] = avg;
-                pixel[(output_channel + 1) % 3] = 0;
-                pixel[(output_channel + 2) % 3] = 0;
+            for (int y = 0; y < converted.rows; y++) {
+                uint8_t* row = dst.ptr<uint8_t>(strip_start + y);
+
+                row_statistics.nr_in_range += image_proc::kernels::limitRow(converted.ptr<uint8_t>(y), row, src.cols, lower, upper);
+                finishRow(row, src.cols, compression_table, statistics ? &row_statistics : nullptr);
             }
-        );
-    }
+        }
+
+        if (statistics) {
+            row_statistics.addTo(*statistics, statistics_mutex);
+        }
+    }, PARALLEL_STRIPES);
 }
 
 /**
- * Iterate over every pixel and set selected channels to the maximum value of that pixel.
- * 
- * @param src: Source image in RGB color space
- * @param dst: Output image (will be overwritten)
- * @param output_channel: wether to choose channel 0, 1, 2 or all (-1)
+ * Manipulate channels, compress and gather statistics in one pass (see manipulateChannels).
+ *
+ * @param src: source image in RGB color space
+ * @param dst: output image (will be overwritten)
+ * @param modifier: what modification to perform
+ * @param channel: which channels should be affected
+ * @param compression_table: table of compressImage, empty for no compression
+ * @param statistics: statistics of dst (will be overwritten), nullptr for none
 */
-void setChannelsToMax(const cv::Mat& src, cv::Mat& dst, const image_proc::ChannelOption& output_channel) {
-    src.copyTo(dst);
-
-    if (output_channel == image_proc::ChannelOption::ALL) {
-        dst.forEach<image_proc::Pixel>(
-            [](image_proc::Pixel& pixel, const int*) -> void {
-                uint8_t max = std::max(pixel[0], pixel[1]);
-                max = std::max(max, pixel[2]);
-
-                pixel[0] = max; pixel[1] = max; pixel[2] = max;
-            }
-        );
-    } else {
-        dst.forEach<image_proc::Pixel>(
-            [output_channel](image_proc::Pixel& pixel, const int*) -> void {
-                uint8_t max = std::max(pixel[0], pixel[1]);
-                max = std::max(max, pixel[2]);
-
-                pixel[output_channel] = max;
-                pixel[(output_channel + 1) % 3] = 0;
-                pixel[(output_channel + 2) % 3] = 0;
-            }
-        );
-    }}
+void manipulateImage(const cv::Mat& src, cv::Mat& dst, const image_proc::ModifierOption& modifier, const image_proc::ChannelOption& channel,
+                     const cv::Mat& compression_table, image_proc::ImageStatistics* statistics) {
+    using image_proc::kernels::Component;
+    using image_proc::ModifierOption;
 
-void image_proc::manipulateChannels(const cv::Mat& src, cv::Mat& dst, const ModifierOption& modifier, const ChannelOption& channel) {
-    int output_channel = channel;
+    assert(src.type() == CV_8UC3);
 
-    cv::Mat temp;
-    int input_channel;
+    Component component = Component::AVERAGE;
     switch (modifier) {
         case ModifierOption::MIN:
-            setChannelsToMin(src, dst, channel);
-            return;
+            component = Component::MINIMUM;
+            break;
         case ModifierOption::AVG:
-            setChannelsToAvg(src, dst, channel);
-            return;
+            component = Component::AVERAGE;
+            break;
         case ModifierOption::MAX:
-            setChannelsToMax(src, dst, channel);
-            return;
+            component = Component::MAXIMUM;
+            break;
         case ModifierOption::RED:
         case ModifierOption::GREEN:
         case ModifierOption::BLUE:
-            src.copyTo(temp);
-            input_channel = modifier;
-
+            component = static_cast<Component>(Component::CHANNEL_0 + modifier);
             break;
         case ModifierOption::HUE:
         case ModifierOption::SAT:
         case ModifierOption::VAL:
-            cv::cvtColor(src, temp, cv::COLOR_RGB2HSV_FULL);
-            input_channel = modifier - 3;
-
+            // computed directly, no conversion of the whole image into HSV
+            component = static_cast<Component>(Component::HUE + modifier - ModifierOption::HUE);
             break;
     }
 
-    std::array<cv::Mat, 3> channels;
-    cv::split(temp, channels);
+    dst.create(src.size(), CV_8UC3);
+    if (statistics) {
+        *statistics = image_proc::ImageStatistics();
+    }
+    std::mutex statistics_mutex;
 
-    cv::Mat output(src.rows, src.cols, CV_8UC3),
-            empty_channel(src.rows, src.cols, CV_8UC1, cv::Scalar(0.0)),
-            selected_channel = channels[input_channel];
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range) -> void {
+        RowStatistics row_statistics;
 
-    switch (channel) {
-        case ChannelOption::ALL:
-            cv::cvtColor(selected_channel, output, cv::COLOR_GRAY2RGB); //pretend to be GRAY
-            break;
-        case ChannelOption::R:
-            {
-                std::array<cv::Mat, 3> new_channels = {selected_channel, empty_channel, empty_channel};
+        for (int y = range.start; y < range.end; y++) {
+            uint8_t* row = dst.ptr<uint8_t>(y);
 
-                cv::merge(new_channels, output);
-            }
-            break;
-        case ChannelOption::G:
-            {
-                std::array<cv::Mat, 3> new_channels = {empty_channel, selected_channel, empty_channel};
+            image_proc::kernels::channelsRow(src.ptr<uint8_t>(y), row, src.cols, component, channel);
+            finishRow(row, src.cols, compression_table, statistics ? &row_statistics : nullptr);
+        }
 
-                cv::merge(new_channels, output);
-            }
-            break;
-        case ChannelOption::B:
-            {
-                std::array<cv::Mat, 3> new_channels = {empty_channel, empty_channel, selected_channel};
+        if (statistics) {
+            row_statistics.addTo(*statistics, statistics_mutex);
+        }
+    }, PARALLEL_STRIPES);
+}
 
-                cv::merge(new_channels, output);
-            }
-            break;
-    }
 
-    dst = std::move(output);
+void image_proc::limitImageByChannels(const cv::Mat& src, cv::Mat& dst, const ColorSpace& color_space,
+                                      const double bottom0, const double top0, const double bottom1, const double top1, const double bottom2, const double top2) {
+    TRACE_SCOPE("limitImageByChannels");
+
+    // same rounding cv::inRange applies to its boundaries
+    const uint8_t lower_boundary[NR_CHANNELS] {cv::saturate_cast<uint8_t>(bottom0), cv::saturate_cast<uint8_t>(bottom1), cv::saturate_cast<uint8_t>(bottom2)},
+                  upper_boundary[NR_CHANNELS] {cv::saturate_cast<uint8_t>(top0),    cv::saturate_cast<uint8_t>(top1),    cv::saturate_cast<uint8_t>(top2)};
+
+    limitImage(src, dst, color_space, lower_boundary, upper_boundary, cv::Mat(), nullptr);
+}
+
+
+void image_proc::manipulateChannels(const cv::Mat& src, cv::Mat& dst, const ModifierOption& modifier, const ChannelOption& channel) {
+    TRACE_SCOPE("manipulateChannels");
+
+    manipulateImage(src, dst, modifier, channel, cv::Mat(), nullptr);
 }
 
 
+const cv::Mat& image_proc::getCompressionTable(double compression_level) {
+    static std::mutex tables_mutex;
+    static std::map<double, cv::Mat> tables;
+
+    std::lock_guard<std::mutex> lock(tables_mutex);
+
+    cv::Mat& table = tables[compression_level];
+    if (table.empty()) {
+        table.create(1, MAX_8BIT + 1, CV_8UC1);
+
+        // exactly the per pixel arithmetic compression used to do, evaluated once per value
+        for (int value = 0; value <= MAX_8BIT; value++) {
+            const uint8_t compressed = value * (compression_level / MAX_8BIT);
+
+            table.at<uint8_t>(value) = static_cast<uint8_t>(compressed * MAX_8BIT / compression_level);
+        }
+    }
+
+    return table;
+}
+
 void image_proc::compressImage(const cv::Mat& src, cv::Mat& dst, double compression_level) {
-    src.copyTo(dst);
+    TRACE_SCOPE("compressImage");
 
     if (compression_level == 8.0) {
+        if (src.data != dst.data) {
+            src.copyTo(dst);
+        }
+
         return;
     }
 
-    // const uint8_t max_value = compression_level;
-    dst.forEach<Pixel>(
-        [compression_level](Pixel& pixel, const int*) -> void {
-            uint8_t pixel_0 = pixel[0] * (compression_level / MAX_8BIT),
-                    pixel_1 = pixel[1] * (compression_level / MAX_8BIT),
-                    pixel_2 = pixel[2] * (compression_level / MAX_8BIT);
+    // one table lookup per channel value, works in place as well
+    cv::LUT(src, image_proc::getCompressionTable(compression_level), dst);
+}
+
+
+void image_proc::applyEdits(const cv::Mat& src, cv::Mat& dst, const EditParameters& parameters, const cv::Mat& converted, ImageStatistics* statistics) {
+    TRACE_SCOPE("applyEdits");
+
+    const cv::Mat compression_table = parameters.compression_level == 8.0 ? cv::Mat() : image_proc::getCompressionTable(parameters.compression_level);
+
+    if (parameters.mode == EditMode::LIMIT) {
+        uint8_t lower[NR_CHANNELS], upper[NR_CHANNELS];
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            lower[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul]);
+            upper[channel] = cv::saturate_cast<uint8_t>(parameters.limits[channel * 2ul + 1ul]);
+        }
+
+        // limiting an already converted image is the same as limiting in RGB without conversion
+        if (!converted.empty()) {
+            limitImage(converted, dst, ColorSpace::RGB, lower, upper, compression_table, statistics);
+        } else {
+            limitImage(src, dst, parameters.color_space, lower, upper, compression_table, statistics);
+        }
+    } else {
+        manipulateImage(src, dst, parameters.modifier, parameters.channel, compression_table, statistics);
+    }
+}
+
+
+void image_proc::ImageStatistics::add(const ImageStatistics& other) {
+    this->nr_pixels   += other.nr_pixels;
+    this->nr_in_range += other.nr_in_range;
+    for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+        for (size_t value = 0ul; value < 256ul; value++) {
+            this->histograms[channel][value] += other.histograms[channel][value];
+        }
+    }
+}
 
-            pixel[0] = pixel_0 * MAX_8BIT / compression_level; //max_value;
-            pixel[1] = pixel_1 * MAX_8BIT / compression_level; //max_value;
-            pixel[2] = pixel_2 * MAX_8BIT / compression_level; //max_value;
+void image_proc::ImageStatistics::compress(const cv::Mat& compression_table) {
+    for (std::array<uint64_t, 256>& histogram: this->histograms) {
+        std::array<uint64_t, 256> compressed {};
+        for (size_t value = 0ul; value < 256ul; value++) {
+            compressed[compression_table.at<uint8_t>(value)] += histogram[value];
         }
-    );
+
+        histogram = compressed;
+    }
+}
+
+uint64_t image_proc::ImageStatistics::sum(size_t channel) const {
+    uint64_t sum = 0ul;
+    for (size_t value = 0ul; value < 256ul; value++) {
+        sum += value * this->histograms[channel][value];
+    }
+
+    return sum;
 }
 
+double image_proc::ImageStatistics::mean(size_t channel) const {
+    return this->nr_pixels ? static_cast<double>(this->sum(channel)) / this->nr_pixels : 0.0;
+}
 
-bool image_proc::loadImage(cv::Mat& image, const std::string& filepath) {
-    cv::Mat temp = cv::imread(filepath);
+
+bool image_proc::loadImage(cv::Mat& image, const std::string& filepath, int imread_flags) {
+    TRACE_SCOPE("loadImage");
+
+    cv::Mat temp = cv::imread(filepath, imread_flags);
     
     if (temp.empty()) {
         return false;
@@ -233,28 +339,83 @@ bool image_proc::loadImage(cv::Mat& image, const std::string& filepath) {
     }
 }
 
-bool image_proc::saveImage(const cv::Mat& image, const std::string& filepath) {
+bool image_proc::saveImage(const cv::Mat& image, const std::string& filepath, const EncoderSettings& settings, bool bgr) {
+    TRACE_SCOPE("saveImage");
+
+    if (bgr) {
+        return cv::imwrite(filepath, image, settings.toImwriteParameters());
+    }
+
     cv::Mat temp;
     cv::cvtColor(image, temp, cv::COLOR_RGB2BGR);
 
-    return cv::imwrite(filepath, temp);
+    return cv::imwrite(filepath, temp, settings.toImwriteParameters());
+}
+
+std::vector<int> image_proc::EncoderSettings::toImwriteParameters() const {
+    std::vector<int> parameters;
+
+    if (this->png_compression != UNSET) {
+        parameters.insert(parameters.end(), {cv::IMWRITE_PNG_COMPRESSION, this->png_compression});
+    }
+    if (this->png_strategy != UNSET) {
+        parameters.insert(parameters.end(), {cv::IMWRITE_PNG_STRATEGY, this->png_strategy});
+    }
+    if (this->jpeg_quality != UNSET) {
+        parameters.insert(parameters.end(), {cv::IMWRITE_JPEG_QUALITY, this->jpeg_quality});
+    }
+    if (this->jpeg_optimize) {
+        parameters.insert(parameters.end(), {cv::IMWRITE_JPEG_OPTIMIZE, 1});
+    }
+
+    return parameters;
 }
 
 
 std::string image_proc::getAverageColorString(const cv::Mat& image) {
-    std::stringstream avg_color_string;
+    TRACE_SCOPE("getAverageColorString");
 
-    cv::Scalar average = cv::mean(image);
-    avg_color_string << std::fixed << std::setfill('0') << std::setprecision(2)
-                     <<   "R: " << average[0]
-                     << "\tG: " << average[1]
-                     << "\tB: " << average[2];
+    const cv::Scalar average = cv::mean(image);
 
-    return avg_color_string.str();
+    return formatAverageColor(average[0], average[1], average[2]);
 }
 
+std::string image_proc::getAverageColorString(const ImageStatistics& statistics) {
+    return formatAverageColor(statistics.mean(0), statistics.mean(1), statistics.mean(2));
+}
+
+
+cv::Mat image_proc::createLimitPreview(const ColorSpace& color_space, size_t channel, int height, int width) {
+    TRACE_SCOPE("createLimitPreview");
+
+    assert(channel < NR_CHANNELS && height > 0 && width > 0);
+
+    uint8_t pixel[NR_CHANNELS];
+    for (size_t i = 0ul; i < NR_CHANNELS; i++) {
+        pixel[i] = cv::saturate_cast<uint8_t>(MAX_8BIT * limit_preview_base_layouts[color_space][i]);
+    }
+
+    cv::Mat preview(height, width, CV_8UC3);
+    for (int y = 0; y < height; y++) {
+        // one value per row, the ends meet the ends of the scale exactly
+        pixel[channel] = cv::saturate_cast<uint8_t>(static_cast<double>(height - y - 1) * MAX_8BIT / std::max(1, height - 1));
+
+        uint8_t* row = preview.ptr<uint8_t>(y);
+        for (int x = 0; x < width; x++) {
+            std::copy(pixel, pixel + NR_CHANNELS, row + x * NR_CHANNELS);
+        }
+    }
+
+    if (image_proc::convert_to_rgb[color_space] != cv::COLOR_COLORCVT_MAX) {
+        cv::cvtColor(preview, preview, image_proc::convert_to_rgb[color_space]);
+    }
+
+    return preview;
+}
 
 void image_proc::convertCVtoGTK(const cv::Mat& src, Gtk::Image& dst) {
+    TRACE_SCOPE("convertCVtoGTK");
+
     assert(src.data != NULL);
 
     Glib::RefPtr<Gdk::Pixbuf> image_buffer = Gdk::Pixbuf::create_from_data(src.data, Gdk::COLORSPACE_RGB, false, 8, src.cols, src.rows, src.step);
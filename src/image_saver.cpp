@@ -0,0 +1,76 @@
+#include <chrono>
+#include <iostream>
+
+#include "image_saver.hpp"
+
+
+ImageSaver::ImageSaver():
+    thread(&ImageSaver::work, this) {}
+
+ImageSaver::~ImageSaver() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_one();
+    this->thread.join();
+}
+
+void ImageSaver::save(const cv::Mat& image, const std::string& filepath, const image_proc::EncoderSettings& settings) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(Job {image, filepath, settings});
+    }
+    this->condition.notify_one();
+}
+
+std::vector<ImageSaver::Result> ImageSaver::takeResults() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    std::vector<Result> results;
+    results.swap(this->results);
+
+    return results;
+}
+
+size_t ImageSaver::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return this->jobs.size() + this->nr_running;
+}
+
+void ImageSaver::work() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->condition.wait(lock, [this]() {return this->stopping || !this->jobs.empty();});
+
+            // queued saves are still written when stopping
+            if (this->jobs.empty()) {
+                return;
+            }
+
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+            this->nr_running++;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        bool success = false;
+        try {
+            success = image_proc::saveImage(job.image, job.filepath, job.settings);
+        } catch (const cv::Exception& exception) {
+            // e.g. an unknown extension, there is no signal handler to catch it on this thread
+            std::cerr << "Unable to save " << job.filepath << ": " << exception.what() << std::endl;
+        }
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->results.push_back(Result {job.filepath, success, duration.count()});
+            this->nr_running--;
+        }
+        this->save_finished.emit();
+    }
+}
@@ -0,0 +1,228 @@
+#include <cairomm/context.h>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "image_view.hpp"
+#include "tracer.hpp"
+
+
+/**
+ * Wrap the pixels of a surface, without copying.
+ *
+ * @param surface: ARGB32 image surface
+ * @return header of the surface pixels (CV_8UC4)
+*/
+cv::Mat wrapSurface(const Cairo::RefPtr<Cairo::ImageSurface>& surface) {
+    return cv::Mat(surface->get_height(), surface->get_width(), CV_8UC4, surface->get_data(), surface->get_stride());
+}
+
+
+void ImageView::setImage(const cv::Mat& image, const cv::Size& display_size) {
+    TRACE_SCOPE("ImageView::setImage");
+
+    assert(image.type() == CV_8UC3);
+
+    const auto fits = [&image](const Cairo::RefPtr<Cairo::ImageSurface>& surface) -> bool {
+        return surface && surface->get_width() == image.cols && surface->get_height() == image.rows;
+    };
+
+    // the surface of this size, otherwise the other one gets replaced
+    size_t target = this->front;
+    if (!fits(this->surfaces[target])) {
+        target = 1ul - this->front;
+
+        if (!fits(this->surfaces[target])) {
+            this->surfaces[target] = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, image.cols, image.rows);
+            this->converted_images[target].release();
+            this->pyramids[target].clear();
+        }
+    }
+
+    // only the rows that differ from the image the surface already holds
+    cv::Range damaged_rows(0, image.rows);
+    const cv::Mat& previous = this->converted_images[target];
+    if (previous.data == image.data) {
+        damaged_rows = cv::Range(0, 0);
+    } else if (!previous.empty()) {
+        const size_t row_bytes = image.cols * image.elemSize();
+
+        while (damaged_rows.start < damaged_rows.end && !std::memcmp(previous.ptr(damaged_rows.start), image.ptr(damaged_rows.start), row_bytes)) {
+            damaged_rows.start++;
+        }
+        while (damaged_rows.end > damaged_rows.start && !std::memcmp(previous.ptr(damaged_rows.end - 1), image.ptr(damaged_rows.end - 1), row_bytes)) {
+            damaged_rows.end--;
+        }
+    }
+
+    // rows an earlier region got written to are converted again in any case
+    const cv::Range& stale = this->stale_rows[target];
+    if (!stale.empty()) {
+        damaged_rows = damaged_rows.empty() ? stale : cv::Range(std::min(damaged_rows.start, stale.start), std::max(damaged_rows.end, stale.end));
+    }
+    this->stale_rows[target] = cv::Range(0, 0);
+
+    if (!damaged_rows.empty()) {
+        this->convert(image.rowRange(damaged_rows), this->surfaces[target], cv::Rect(0, damaged_rows.start, image.cols, damaged_rows.size()));
+    }
+    this->converted_images[target] = image;
+
+    const bool swapped = target != this->front;
+    this->front = target;
+
+    const cv::Size new_display_size = display_size.area() > 0 ? display_size : image.size();
+    if (new_display_size != this->display_size) {
+        this->display_size = new_display_size;
+        this->updateSizeRequest();
+        this->queue_draw();
+    } else if (swapped) {
+        this->queue_draw();
+    }
+
+    if (!damaged_rows.empty()) {
+        this->damage(target, damaged_rows);
+    }
+}
+
+bool ImageView::setRegion(const cv::Mat& image, const cv::Rect& region) {
+    TRACE_SCOPE("ImageView::setRegion");
+
+    assert(image.type() == CV_8UC3 && image.size() == region.size());
+
+    size_t target = 0ul;
+    while (target < this->surfaces.size() && !(this->surfaces[target] && this->surfaces[target]->get_width()  == this->display_size.width
+                                                                       && this->surfaces[target]->get_height() == this->display_size.height)) {
+        target++;
+    }
+    if (target == this->surfaces.size() || (region & cv::Rect(cv::Point(), this->display_size)) != region) {
+        return false;
+    }
+
+    this->convert(image, this->surfaces[target], region);
+
+    // the next complete frame cannot skip these rows, even if they match the converted image
+    const cv::Range rows(region.y, region.y + region.height);
+    const cv::Range& stale = this->stale_rows[target];
+    this->stale_rows[target] = stale.empty() ? rows : cv::Range(std::min(stale.start, rows.start), std::max(stale.end, rows.end));
+
+    if (target != this->front) {
+        this->front = target;
+        this->queue_draw();
+    }
+    this->damage(target, rows);
+
+    return true;
+}
+
+void ImageView::setZoom(double zoom) {
+    if (zoom == this->zoom) {
+        return;
+    }
+
+    // nothing gets resampled here, drawing picks the pyramid level
+    this->zoom = zoom;
+    this->updateSizeRequest();
+    this->queue_draw();
+}
+
+bool ImageView::on_draw(const Cairo::RefPtr<Cairo::Context>& context) {
+    TRACE_SCOPE("ImageView::draw");
+
+    const Cairo::RefPtr<Cairo::ImageSurface>& surface = this->surfaces[this->front];
+    if (!surface) {
+        return true;
+    }
+
+    // the smallest level that still has at least as many pixels as get shown
+    const double width  = this->display_size.width  * this->zoom,
+                 height = this->display_size.height * this->zoom;
+    const double scale  = std::min(width / surface->get_width(), height / surface->get_height());
+
+    size_t level = 0ul;
+    while (scale * (2ul << level) <= 1.0 && (surface->get_width() >> (level + 1ul)) > 0 && (surface->get_height() >> (level + 1ul)) > 0) {
+        level++;
+    }
+    const Cairo::RefPtr<Cairo::ImageSurface> source = this->getLevel(this->front, level);
+
+    // Gtk clips to the invalidated and visible area, so only that part gets resampled
+    context->scale(width / source->get_width(), height / source->get_height());
+
+    const Cairo::RefPtr<Cairo::SurfacePattern> pattern = Cairo::SurfacePattern::create(source);
+    pattern->set_filter(scale > 1.0 ? Cairo::FILTER_NEAREST : Cairo::FILTER_BILINEAR);
+    context->set_source(pattern);
+    context->paint();
+
+    return true;
+}
+
+void ImageView::convert(const cv::Mat& pixels, const Cairo::RefPtr<Cairo::ImageSurface>& surface, const cv::Rect& area) {
+    TRACE_SCOPE("ImageView::convert");
+
+    surface->flush();
+
+    // ARGB32 is a native endian 32bit word, on little endian machines the bytes are B, G, R, A
+    cv::Mat damaged_pixels = wrapSurface(surface)(area);
+    cv::cvtColor(pixels, damaged_pixels, cv::COLOR_RGB2BGRA);
+
+    surface->mark_dirty(area.x, area.y, area.width, area.height);
+}
+
+void ImageView::damage(size_t index, const cv::Range& rows) {
+    // levels built so far get updated on their next use, only where they depend on the damaged rows
+    cv::Range level_rows = rows;
+    for (Level& level: this->pyramids[index]) {
+        level_rows = cv::Range(level_rows.start / 2, std::min((level_rows.end + 1) / 2, level.surface->get_height()));
+        if (level.dirty_rows.empty()) {
+            level.dirty_rows = level_rows;
+        } else {
+            level.dirty_rows = cv::Range(std::min(level.dirty_rows.start, level_rows.start), std::max(level.dirty_rows.end, level_rows.end));
+        }
+    }
+
+    if (index == this->front) {
+        const double scale = this->display_size.height * this->zoom / this->surfaces[index]->get_height();
+        const int top    = static_cast<int>(std::floor(rows.start * scale)),
+                  bottom = static_cast<int>(std::ceil(rows.end * scale));
+
+        this->queue_draw_area(0, top, this->get_allocated_width(), bottom - top);
+    }
+}
+
+Cairo::RefPtr<Cairo::ImageSurface> ImageView::getLevel(size_t index, size_t level) {
+    std::vector<Level>& pyramid = this->pyramids[index];
+
+    Cairo::RefPtr<Cairo::ImageSurface> below = this->surfaces[index];
+    for (size_t i = 0ul; i < level; i++) {
+        // half the size, a trailing odd row or column is dropped so every pixel averages exactly 2x2 pixels
+        if (i == pyramid.size()) {
+            const int width = below->get_width() / 2, height = below->get_height() / 2;
+            pyramid.push_back({Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, width, height), cv::Range(0, height)});
+        }
+
+        Level& current = pyramid[i];
+        if (!current.dirty_rows.empty()) {
+            TRACE_SCOPE("ImageView::buildLevel");
+
+            const cv::Mat below_pixels = wrapSurface(below);
+            cv::Mat pixels = wrapSurface(current.surface).rowRange(current.dirty_rows);
+
+            current.surface->flush();
+            cv::resize(below_pixels(cv::Range(current.dirty_rows.start * 2, current.dirty_rows.end * 2), cv::Range(0, pixels.cols * 2)),
+                       pixels, pixels.size(), 0.0, 0.0, cv::INTER_AREA);
+            current.surface->mark_dirty(0, current.dirty_rows.start, pixels.cols, current.dirty_rows.size());
+
+            current.dirty_rows = cv::Range(0, 0);
+        }
+
+        below = current.surface;
+    }
+
+    return below;
+}
+
+void ImageView::updateSizeRequest() {
+    this->set_size_request(std::max(1, cvRound(this->display_size.width  * this->zoom)),
+                           std::max(1, cvRound(this->display_size.height * this->zoom)));
+}
@@ -0,0 +1,208 @@
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <array>
+
+#include "kernels.hpp"
+
+
+size_t image_proc::kernels::scalar::limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper) {
+    size_t nr_in_range = 0ul;
+
+    for (size_t x = 0ul; x < width; x++, src += NR_CHANNELS, dst += NR_CHANNELS) {
+        const uint8_t c0 = src[0], c1 = src[1], c2 = src[2];
+
+        if (lower[0] <= c0 && c0 <= upper[0] &&
+            lower[1] <= c1 && c1 <= upper[1] &&
+            lower[2] <= c2 && c2 <= upper[2]) {
+            dst[0] = c0; dst[1] = c1; dst[2] = c2;
+            nr_in_range++;
+        } else {
+            const uint8_t gray = (c0 * GRAY_WEIGHT_R + c1 * GRAY_WEIGHT_G + c2 * GRAY_WEIGHT_B + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT;
+
+            dst[0] = gray; dst[1] = gray; dst[2] = gray;
+        }
+    }
+
+    return nr_in_range;
+}
+
+/**
+ * Build the reciprocal tables cv::COLOR_RGB2HSV_FULL divides by.
+ *
+ * @param numerator: fixed point numerator
+ * @param divisor_factor: factor the table index gets multiplied with
+ * @return rounded numerator / (index * divisor_factor), 0 for index 0
+*/
+std::array<int, 256> hsvDivisionTable(int numerator, int divisor_factor) {
+    std::array<int, 256> table;
+
+    table[0] = 0;
+    for (int i = 1; i < 256; i++) {
+        table[i] = cvRound(numerator / static_cast<double>(divisor_factor * i));
+    }
+
+    return table;
+}
+
+const std::array<int, 256> saturation_divisions = hsvDivisionTable(0xFF << HSV_SHIFT, 1),
+                           hue_divisions        = hsvDivisionTable(HSV_HUE_RANGE << HSV_SHIFT, 6);
+
+/**
+ * Compute the value of a component for one pixel.
+*/
+template <int COMPONENT>
+static inline uint8_t componentValue(const uint8_t* pixel) {
+    if constexpr (COMPONENT >= image_proc::kernels::Component::HUE) {
+        // same integer arithmetic as OpenCV's RGB2HSV_b
+        const int r = pixel[0], g = pixel[1], b = pixel[2];
+        const int v = std::max({r, g, b}), diff = v - std::min({r, g, b});
+
+        if constexpr (COMPONENT == image_proc::kernels::Component::VALUE) {
+            return v;
+        } else if constexpr (COMPONENT == image_proc::kernels::Component::SATURATION) {
+            return (diff * saturation_divisions[v] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+        } else {
+            int h = v == r ? g - b : (v == g ? b - r + 2 * diff : r - g + 4 * diff);
+            h = (h * hue_divisions[diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+            h += h < 0 ? HSV_HUE_RANGE : 0;
+
+            return cv::saturate_cast<uint8_t>(h);
+        }
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::MINIMUM) {
+        return std::min({pixel[0], pixel[1], pixel[2]});
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::AVERAGE) {
+        return (pixel[0] + pixel[1] + pixel[2]) / 3u;
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::MAXIMUM) {
+        return std::max({pixel[0], pixel[1], pixel[2]});
+    } else {
+        return pixel[COMPONENT - image_proc::kernels::Component::CHANNEL_0];
+    }
+}
+
+/**
+ * Channels kernel for one component and output channel (-1 for all).
+*/
+template <int COMPONENT, int OUTPUT_CHANNEL>
+static void channelsRowKernel(const uint8_t* src, uint8_t* dst, size_t width) {
+    for (size_t x = 0ul; x < width; x++, src += NR_CHANNELS, dst += NR_CHANNELS) {
+        const uint8_t value = componentValue<COMPONENT>(src);
+
+        if constexpr (OUTPUT_CHANNEL < 0) {
+            dst[0] = value; dst[1] = value; dst[2] = value;
+        } else {
+            dst[0] = OUTPUT_CHANNEL == 0 ? value : 0u;
+            dst[1] = OUTPUT_CHANNEL == 1 ? value : 0u;
+            dst[2] = OUTPUT_CHANNEL == 2 ? value : 0u;
+        }
+    }
+}
+
+DEFINE_CHANNELS_ROW_KERNELS(channelsRowKernel);
+
+void image_proc::kernels::scalar::channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel) {
+    channels_row_kernels[component][output_channel + 1](src, dst, width);
+}
+
+void image_proc::kernels::scalar::lookup3DRow(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* table) {
+    for (size_t x = 0ul; x < width; x++, src += NR_CHANNELS, dst += NR_CHANNELS) {
+        const uint32_t pixel = table[(src[0] << 16) | (src[1] << 8) | src[2]];
+
+        dst[0] = pixel; dst[1] = pixel >> 8; dst[2] = pixel >> 16;
+    }
+}
+
+
+enum InstructionSet {
+    SCALAR,
+    SSE4,
+    AVX2
+};
+
+/**
+ * Choose the best kernel implementation for the CPU we are running on.
+ * Respects OPENCV_CPU_DISABLE, so the scalar kernels can be forced for comparison.
+ *
+ * @return instruction set to be used
+*/
+InstructionSet selectInstructionSet() {
+#ifdef HAVE_AVX2_KERNELS
+    if (cv::checkHardwareSupport(CV_CPU_AVX2)) {
+        return InstructionSet::AVX2;
+    }
+#endif
+#ifdef HAVE_SSE4_KERNELS
+    if (cv::checkHardwareSupport(CV_CPU_SSE4_1)) {
+        return InstructionSet::SSE4;
+    }
+#endif
+    return InstructionSet::SCALAR;
+}
+
+const InstructionSet instruction_set = selectInstructionSet();
+
+
+size_t image_proc::kernels::limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper) {
+    switch (instruction_set) {
+#ifdef HAVE_AVX2_KERNELS
+        case InstructionSet::AVX2:
+            return avx2::limitRow(src, dst, width, lower, upper);
+#endif
+#ifdef HAVE_SSE4_KERNELS
+        case InstructionSet::SSE4:
+            return sse4::limitRow(src, dst, width, lower, upper);
+#endif
+        default:
+            return scalar::limitRow(src, dst, width, lower, upper);
+    }
+}
+
+void image_proc::kernels::channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel) {
+    switch (instruction_set) {
+#ifdef HAVE_AVX2_KERNELS
+        case InstructionSet::AVX2:
+            return avx2::channelsRow(src, dst, width, component, output_channel);
+#endif
+#ifdef HAVE_SSE4_KERNELS
+        case InstructionSet::SSE4:
+            return sse4::channelsRow(src, dst, width, component, output_channel);
+#endif
+        default:
+            return scalar::channelsRow(src, dst, width, component, output_channel);
+    }
+}
+
+void image_proc::kernels::lookup3DRow(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* table) {
+    // gathers are AVX2 only, SSE4 CPUs use the scalar kernel
+    switch (instruction_set) {
+#ifdef HAVE_AVX2_KERNELS
+        case InstructionSet::AVX2:
+            return avx2::lookup3DRow(src, dst, width, table);
+#endif
+        default:
+            return scalar::lookup3DRow(src, dst, width, table);
+    }
+}
+
+void image_proc::kernels::histogramRow(const uint8_t* row, size_t width, uint32_t* histograms) {
+    uint32_t* histogram0 = histograms;
+    uint32_t* histogram1 = histograms + 256;
+    uint32_t* histogram2 = histograms + 512;
+
+    for (size_t x = 0ul; x < width; x++, row += NR_CHANNELS) {
+        histogram0[row[0]]++;
+        histogram1[row[1]]++;
+        histogram2[row[2]]++;
+    }
+}
+
+std::string image_proc::kernels::instructionSet() {
+    switch (instruction_set) {
+        case InstructionSet::AVX2:
+            return "avx2";
+        case InstructionSet::SSE4:
+            return "sse4.1";
+        default:
+            return "scalar";
+    }
+}
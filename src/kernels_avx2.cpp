@@ -0,0 +1,280 @@
+// compiled with -mavx2, only called after a runtime check
+#include <immintrin.h>
+
+#include <cstring>
+
+#include "kernels.hpp"
+
+
+/**
+ * AVX2 shuffles only work within 128bit lanes, so 32 pixels are loaded as two independent groups of 16:
+ * lane 0 holds pixels 0-15 and lane 1 pixels 16-31. All per pixel work then happens lane wise with the
+ * same byte patterns as the SSE4 kernels.
+*/
+
+/**
+ * Broadcast a 16 byte pattern into both lanes.
+*/
+static inline __m256i lanePattern(char e0, char e1, char e2,  char e3,  char e4,  char e5,  char e6,  char e7,
+                                  char e8, char e9, char e10, char e11, char e12, char e13, char e14, char e15) {
+    return _mm256_broadcastsi128_si256(_mm_setr_epi8(e0, e1, e2, e3, e4, e5, e6, e7, e8, e9, e10, e11, e12, e13, e14, e15));
+}
+
+/**
+ * Load 48 bytes from each of two locations into the two lanes of three registers.
+*/
+static inline void load2x48(const uint8_t* lane0, const uint8_t* lane1, __m256i& a, __m256i& b, __m256i& c) {
+    a = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lane0))),
+                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane1)), 1);
+    b = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lane0 + 16))),
+                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane1 + 16)), 1);
+    c = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(lane0 + 32))),
+                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane1 + 32)), 1);
+}
+
+/**
+ * Store the two lanes of three registers as 48 bytes to each of two locations.
+*/
+static inline void store2x48(uint8_t* lane0, uint8_t* lane1, __m256i a, __m256i b, __m256i c) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane0),      _mm256_castsi256_si128(a));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane0 + 16), _mm256_castsi256_si128(b));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane0 + 32), _mm256_castsi256_si128(c));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane1),      _mm256_extracti128_si256(a, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane1 + 16), _mm256_extracti128_si256(b, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lane1 + 32), _mm256_extracti128_si256(c, 1));
+}
+
+/**
+ * Split 2x16 interleaved pixels into one register per channel (lane wise).
+*/
+static inline void deinterleave(__m256i a, __m256i b, __m256i c, __m256i& c0, __m256i& c1, __m256i& c2) {
+    c0 = _mm256_or_si256(_mm256_or_si256(
+            _mm256_shuffle_epi8(a, lanePattern( 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm256_shuffle_epi8(b, lanePattern(-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1))),
+            _mm256_shuffle_epi8(c, lanePattern(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13)));
+    c1 = _mm256_or_si256(_mm256_or_si256(
+            _mm256_shuffle_epi8(a, lanePattern( 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm256_shuffle_epi8(b, lanePattern(-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1))),
+            _mm256_shuffle_epi8(c, lanePattern(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14)));
+    c2 = _mm256_or_si256(_mm256_or_si256(
+            _mm256_shuffle_epi8(a, lanePattern( 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm256_shuffle_epi8(b, lanePattern(-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1))),
+            _mm256_shuffle_epi8(c, lanePattern(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15)));
+}
+
+/**
+ * Repeat every byte three times (lane wise).
+*/
+static inline void triplicate(__m256i v, __m256i& a, __m256i& b, __m256i& c) {
+    a = _mm256_shuffle_epi8(v, lanePattern( 0,  0,  0,  1,  1,  1,  2,  2,  2,  3,  3,  3,  4,  4,  4,  5));
+    b = _mm256_shuffle_epi8(v, lanePattern( 5,  5,  6,  6,  6,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10, 10));
+    c = _mm256_shuffle_epi8(v, lanePattern(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15));
+}
+
+/**
+ * Compute the fixed point gray value of 2x8 pixels given as 16bit channels.
+*/
+static inline __m256i gray16(__m256i c0, __m256i c1, __m256i c2) {
+    const __m256i weights01 = _mm256_set1_epi32((GRAY_WEIGHT_G << 16) | GRAY_WEIGHT_R),
+                  weights2r = _mm256_set1_epi32(((1 << (GRAY_SHIFT - 1)) << 16) | GRAY_WEIGHT_B),
+                  ones      = _mm256_set1_epi16(1);
+
+    const __m256i lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(c0, c1),   weights01),
+                                        _mm256_madd_epi16(_mm256_unpacklo_epi16(c2, ones), weights2r)),
+                  hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(c0, c1),   weights01),
+                                        _mm256_madd_epi16(_mm256_unpackhi_epi16(c2, ones), weights2r));
+
+    return _mm256_packs_epi32(_mm256_srli_epi32(lo, GRAY_SHIFT), _mm256_srli_epi32(hi, GRAY_SHIFT));
+}
+
+/**
+ * Test 32 values against inclusive unsigned bounds.
+*/
+static inline __m256i inRange(__m256i v, __m256i lower, __m256i upper) {
+    return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, lower), v), _mm256_cmpeq_epi8(_mm256_min_epu8(v, upper), v));
+}
+
+/**
+ * Compute a HSV component for 8 pixels given as 32bit channels, with the arithmetic of the scalar kernel.
+ * The reciprocal tables are replaced by rounded float divisions, which give the same integers for all 8bit inputs.
+*/
+template <int COMPONENT>
+static inline __m256i hsvComponent8(__m256i r, __m256i g, __m256i b) {
+    const __m256i v    = _mm256_max_epi32(_mm256_max_epi32(r, g), b),
+                  diff = _mm256_sub_epi32(v, _mm256_min_epi32(_mm256_min_epi32(r, g), b)),
+                  half = _mm256_set1_epi32(1 << (HSV_SHIFT - 1));
+
+    if constexpr (COMPONENT == image_proc::kernels::Component::SATURATION) {
+        // v = 0 divides by zero, but then diff is 0 as well
+        const __m256i division = _mm256_cvtps_epi32(_mm256_div_ps(_mm256_set1_ps(0xFF << HSV_SHIFT), _mm256_cvtepi32_ps(v)));
+
+        return _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(diff, division), half), HSV_SHIFT);
+    } else {
+        const __m256i is_r = _mm256_cmpeq_epi32(v, r), is_g = _mm256_cmpeq_epi32(v, g);
+
+        // r is checked first, then g
+        __m256i h = _mm256_blendv_epi8(
+            _mm256_blendv_epi8(_mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_slli_epi32(diff, 2)), _mm256_add_epi32(_mm256_sub_epi32(b, r), _mm256_slli_epi32(diff, 1)), is_g),
+            _mm256_sub_epi32(g, b),
+            is_r
+        );
+
+        // diff = 0 divides by zero, but then h is 0 as well
+        const __m256i division = _mm256_cvtps_epi32(_mm256_div_ps(_mm256_set1_ps(HSV_HUE_RANGE << HSV_SHIFT), _mm256_cvtepi32_ps(_mm256_mullo_epi32(diff, _mm256_set1_epi32(6)))));
+        h = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(h, division), half), HSV_SHIFT);
+
+        return _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), h), _mm256_set1_epi32(HSV_HUE_RANGE)));
+    }
+}
+
+/**
+ * Widen 8 bytes of a channel (the given half of the given lane) to 32bit.
+*/
+template <int LANE, int HALF>
+static inline __m256i widen8(__m256i channel) {
+    return _mm256_cvtepu8_epi32(_mm_srli_si128(_mm256_extracti128_si256(channel, LANE), 8 * HALF));
+}
+
+/**
+ * Compute the value of a component for 2x16 pixels given as deinterleaved channels.
+*/
+template <int COMPONENT>
+static inline __m256i componentValues(__m256i c0, __m256i c1, __m256i c2) {
+    if constexpr (COMPONENT == image_proc::kernels::Component::HUE || COMPONENT == image_proc::kernels::Component::SATURATION) {
+        const __m256i q0 = hsvComponent8<COMPONENT>(widen8<0, 0>(c0), widen8<0, 0>(c1), widen8<0, 0>(c2)),
+                      q1 = hsvComponent8<COMPONENT>(widen8<0, 1>(c0), widen8<0, 1>(c1), widen8<0, 1>(c2)),
+                      q2 = hsvComponent8<COMPONENT>(widen8<1, 0>(c0), widen8<1, 0>(c1), widen8<1, 0>(c2)),
+                      q3 = hsvComponent8<COMPONENT>(widen8<1, 1>(c0), widen8<1, 1>(c1), widen8<1, 1>(c2));
+
+        // saturating packs work lane wise, the permutes restore the pixel order (a hue of 256 becomes 255 like in OpenCV)
+        const __m256i q01 = _mm256_permute4x64_epi64(_mm256_packus_epi32(q0, q1), 0xD8),
+                      q23 = _mm256_permute4x64_epi64(_mm256_packus_epi32(q2, q3), 0xD8);
+
+        return _mm256_permute4x64_epi64(_mm256_packus_epi16(q01, q23), 0xD8);
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::MINIMUM) {
+        return _mm256_min_epu8(_mm256_min_epu8(c0, c1), c2);
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::AVERAGE) {
+        // sum * 21846 >> 16 equals sum / 3 for all sums up to 765
+        const __m256i zero = _mm256_setzero_si256(), third = _mm256_set1_epi16(21846);
+
+        const __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(c0, zero), _mm256_unpacklo_epi8(c1, zero)), _mm256_unpacklo_epi8(c2, zero)),
+                      hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(c0, zero), _mm256_unpackhi_epi8(c1, zero)), _mm256_unpackhi_epi8(c2, zero));
+
+        return _mm256_packus_epi16(_mm256_mulhi_epu16(lo, third), _mm256_mulhi_epu16(hi, third));
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::MAXIMUM || COMPONENT == image_proc::kernels::Component::VALUE) {
+        return _mm256_max_epu8(_mm256_max_epu8(c0, c1), c2);
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::CHANNEL_0) {
+        return c0;
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::CHANNEL_1) {
+        return c1;
+    } else {
+        return c2;
+    }
+}
+
+/**
+ * Mask selecting the bytes of one channel within the block-th 16 bytes of interleaved pixels (both lanes).
+*/
+static inline __m256i channelMask(int channel, int block) {
+    alignas(16) int8_t mask[16];
+    for (int i = 0; i < 16; i++) {
+        mask[i] = (block * 16 + i) % 3 == channel ? -1 : 0;
+    }
+
+    return _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(mask)));
+}
+
+/**
+ * Store the lower 12 bytes of a register.
+*/
+static inline void store12(uint8_t* dst, __m128i v) {
+    const uint32_t last = _mm_extract_epi32(v, 2);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), v);
+    std::memcpy(dst + 8, &last, sizeof(last));
+}
+
+/**
+ * Channels kernel for one component and output channel (-1 for all).
+*/
+template <int COMPONENT, int OUTPUT_CHANNEL>
+static void channelsRowKernel(const uint8_t* src, uint8_t* dst, size_t width) {
+    const __m256i mask_a = channelMask(OUTPUT_CHANNEL, 0), mask_b = channelMask(OUTPUT_CHANNEL, 1), mask_c = channelMask(OUTPUT_CHANNEL, 2);
+
+    size_t x = 0ul;
+    for (; x + 32ul <= width; x += 32ul, src += 96, dst += 96) {
+        __m256i a, b, c, c0, c1, c2, out_a, out_b, out_c;
+        load2x48(src, src + 48, a, b, c);
+        deinterleave(a, b, c, c0, c1, c2);
+        triplicate(componentValues<COMPONENT>(c0, c1, c2), out_a, out_b, out_c);
+
+        if constexpr (OUTPUT_CHANNEL >= 0) {
+            out_a = _mm256_and_si256(out_a, mask_a);
+            out_b = _mm256_and_si256(out_b, mask_b);
+            out_c = _mm256_and_si256(out_c, mask_c);
+        }
+
+        store2x48(dst, dst + 48, out_a, out_b, out_c);
+    }
+
+    image_proc::kernels::scalar::channelsRow(src, dst, width - x, static_cast<image_proc::kernels::Component>(COMPONENT), OUTPUT_CHANNEL);
+}
+
+DEFINE_CHANNELS_ROW_KERNELS(channelsRowKernel);
+
+
+size_t image_proc::kernels::avx2::limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper) {
+    const __m256i lower0 = _mm256_set1_epi8(lower[0]), upper0 = _mm256_set1_epi8(upper[0]),
+                  lower1 = _mm256_set1_epi8(lower[1]), upper1 = _mm256_set1_epi8(upper[1]),
+                  lower2 = _mm256_set1_epi8(lower[2]), upper2 = _mm256_set1_epi8(upper[2]),
+                  zero   = _mm256_setzero_si256();
+
+    size_t nr_in_range = 0ul, x = 0ul;
+    for (; x + 32ul <= width; x += 32ul, src += 96, dst += 96) {
+        __m256i a, b, c, c0, c1, c2;
+        load2x48(src, src + 48, a, b, c);
+        deinterleave(a, b, c, c0, c1, c2);
+
+        const __m256i mask = _mm256_and_si256(_mm256_and_si256(inRange(c0, lower0, upper0), inRange(c1, lower1, upper1)),
+                                              inRange(c2, lower2, upper2));
+        const __m256i gray = _mm256_packus_epi16(
+            gray16(_mm256_unpacklo_epi8(c0, zero), _mm256_unpacklo_epi8(c1, zero), _mm256_unpacklo_epi8(c2, zero)),
+            gray16(_mm256_unpackhi_epi8(c0, zero), _mm256_unpackhi_epi8(c1, zero), _mm256_unpackhi_epi8(c2, zero))
+        );
+        nr_in_range += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(mask)));
+
+        __m256i gray_a, gray_b, gray_c, mask_a, mask_b, mask_c;
+        triplicate(gray, gray_a, gray_b, gray_c);
+        triplicate(mask, mask_a, mask_b, mask_c);
+
+        store2x48(dst, dst + 48, _mm256_blendv_epi8(gray_a, a, mask_a), _mm256_blendv_epi8(gray_b, b, mask_b), _mm256_blendv_epi8(gray_c, c, mask_c));
+    }
+
+    return nr_in_range + scalar::limitRow(src, dst, width - x, lower, upper);
+}
+
+void image_proc::kernels::avx2::channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel) {
+    channels_row_kernels[component][output_channel + 1](src, dst, width);
+}
+
+void image_proc::kernels::avx2::lookup3DRow(const uint8_t* src, uint8_t* dst, size_t width, const uint32_t* table) {
+    // 4 pixels per lane: bytes to table indices (r << 16) | (g << 8) | b and gathered entries back to bytes
+    const __m256i to_indices = lanePattern(2, 1, 0, -1, 5, 4,  3, -1,  8,  7,  6, -1, 11, 10,  9, -1),
+                  to_pixels  = lanePattern(0, 1, 2,  4, 5, 6,  8,  9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    // the second lane reads 16 bytes from pixel 4 on, so 10 pixels have to be left
+    size_t x = 0ul;
+    for (; x + 10ul <= width; x += 8ul, src += 24, dst += 24) {
+        const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+                                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+        const __m256i result = _mm256_shuffle_epi8(
+            _mm256_i32gather_epi32(reinterpret_cast<const int*>(table), _mm256_shuffle_epi8(pixels, to_indices), 4),
+            to_pixels
+        );
+
+        store12(dst,      _mm256_castsi256_si128(result));
+        store12(dst + 12, _mm256_extracti128_si256(result, 1));
+    }
+
+    scalar::lookup3DRow(src, dst, width - x, table);
+}
@@ -0,0 +1,226 @@
+// compiled with -msse4.1, only called after a runtime check
+#include <smmintrin.h>
+
+#include "kernels.hpp"
+
+
+/**
+ * Split 16 interleaved pixels (48 bytes in a, b, c) into one register per channel.
+ *
+ * @param a, b, c: the three consecutive 16 byte blocks
+ * @param c0, c1, c2: output channels
+*/
+static inline void deinterleave(__m128i a, __m128i b, __m128i c, __m128i& c0, __m128i& c1, __m128i& c2) {
+    c0 = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a, _mm_setr_epi8( 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13)));
+    c1 = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a, _mm_setr_epi8( 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14)));
+    c2 = _mm_or_si128(_mm_or_si128(
+            _mm_shuffle_epi8(a, _mm_setr_epi8( 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+            _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1))),
+            _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15)));
+}
+
+/**
+ * Repeat every byte of a register three times, resulting in 48 bytes (a, b, c).
+ *
+ * @param v: 16 values
+ * @param a, b, c: output blocks
+*/
+static inline void triplicate(__m128i v, __m128i& a, __m128i& b, __m128i& c) {
+    a = _mm_shuffle_epi8(v, _mm_setr_epi8( 0,  0,  0,  1,  1,  1,  2,  2,  2,  3,  3,  3,  4,  4,  4,  5));
+    b = _mm_shuffle_epi8(v, _mm_setr_epi8( 5,  5,  6,  6,  6,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10, 10));
+    c = _mm_shuffle_epi8(v, _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15));
+}
+
+/**
+ * Compute the fixed point gray value of 8 pixels given as 16bit channels.
+ *
+ * @param c0, c1, c2: 16bit channels
+ * @return 8 gray values (16bit)
+*/
+static inline __m128i gray8(__m128i c0, __m128i c1, __m128i c2) {
+    const __m128i weights01 = _mm_setr_epi16(GRAY_WEIGHT_R, GRAY_WEIGHT_G, GRAY_WEIGHT_R, GRAY_WEIGHT_G,
+                                             GRAY_WEIGHT_R, GRAY_WEIGHT_G, GRAY_WEIGHT_R, GRAY_WEIGHT_G),
+                  weights2r = _mm_setr_epi16(GRAY_WEIGHT_B, 1 << (GRAY_SHIFT - 1), GRAY_WEIGHT_B, 1 << (GRAY_SHIFT - 1),
+                                             GRAY_WEIGHT_B, 1 << (GRAY_SHIFT - 1), GRAY_WEIGHT_B, 1 << (GRAY_SHIFT - 1)),
+                  ones      = _mm_set1_epi16(1);
+
+    const __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(c0, c1),   weights01),
+                                     _mm_madd_epi16(_mm_unpacklo_epi16(c2, ones), weights2r)),
+                  hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(c0, c1),   weights01),
+                                     _mm_madd_epi16(_mm_unpackhi_epi16(c2, ones), weights2r));
+
+    return _mm_packs_epi32(_mm_srli_epi32(lo, GRAY_SHIFT), _mm_srli_epi32(hi, GRAY_SHIFT));
+}
+
+/**
+ * Test 16 values against inclusive unsigned bounds.
+ *
+ * @return 0xFF for every value within the bounds, 0x00 otherwise
+*/
+static inline __m128i inRange(__m128i v, __m128i lower, __m128i upper) {
+    return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lower), v), _mm_cmpeq_epi8(_mm_min_epu8(v, upper), v));
+}
+
+/**
+ * Compute a HSV component for 4 pixels given as 32bit channels, with the arithmetic of the scalar kernel.
+ * The reciprocal tables are replaced by rounded float divisions, which give the same integers for all 8bit inputs.
+*/
+template <int COMPONENT>
+static inline __m128i hsvComponent4(__m128i r, __m128i g, __m128i b) {
+    const __m128i v    = _mm_max_epi32(_mm_max_epi32(r, g), b),
+                  diff = _mm_sub_epi32(v, _mm_min_epi32(_mm_min_epi32(r, g), b)),
+                  half = _mm_set1_epi32(1 << (HSV_SHIFT - 1));
+
+    if constexpr (COMPONENT == image_proc::kernels::Component::SATURATION) {
+        // v = 0 divides by zero, but then diff is 0 as well
+        const __m128i division = _mm_cvtps_epi32(_mm_div_ps(_mm_set1_ps(0xFF << HSV_SHIFT), _mm_cvtepi32_ps(v)));
+
+        return _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(diff, division), half), HSV_SHIFT);
+    } else {
+        const __m128i is_r = _mm_cmpeq_epi32(v, r), is_g = _mm_cmpeq_epi32(v, g);
+
+        // r is checked first, then g
+        __m128i h = _mm_blendv_epi8(
+            _mm_blendv_epi8(_mm_add_epi32(_mm_sub_epi32(r, g), _mm_slli_epi32(diff, 2)), _mm_add_epi32(_mm_sub_epi32(b, r), _mm_slli_epi32(diff, 1)), is_g),
+            _mm_sub_epi32(g, b),
+            is_r
+        );
+
+        // diff = 0 divides by zero, but then h is 0 as well
+        const __m128i division = _mm_cvtps_epi32(_mm_div_ps(_mm_set1_ps(HSV_HUE_RANGE << HSV_SHIFT), _mm_cvtepi32_ps(_mm_mullo_epi32(diff, _mm_set1_epi32(6)))));
+        h = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(h, division), half), HSV_SHIFT);
+
+        return _mm_add_epi32(h, _mm_and_si128(_mm_cmplt_epi32(h, _mm_setzero_si128()), _mm_set1_epi32(HSV_HUE_RANGE)));
+    }
+}
+
+/**
+ * Compute the value of a component for 16 pixels given as deinterleaved channels.
+*/
+template <int COMPONENT>
+static inline __m128i componentValues(__m128i c0, __m128i c1, __m128i c2) {
+    if constexpr (COMPONENT == image_proc::kernels::Component::HUE || COMPONENT == image_proc::kernels::Component::SATURATION) {
+        const __m128i q0 = hsvComponent4<COMPONENT>(_mm_cvtepu8_epi32(c0), _mm_cvtepu8_epi32(c1), _mm_cvtepu8_epi32(c2)),
+                      q1 = hsvComponent4<COMPONENT>(_mm_cvtepu8_epi32(_mm_srli_si128(c0, 4)),
+                                                    _mm_cvtepu8_epi32(_mm_srli_si128(c1, 4)),
+                                                    _mm_cvtepu8_epi32(_mm_srli_si128(c2, 4))),
+                      q2 = hsvComponent4<COMPONENT>(_mm_cvtepu8_epi32(_mm_srli_si128(c0, 8)),
+                                                    _mm_cvtepu8_epi32(_mm_srli_si128(c1, 8)),
+                                                    _mm_cvtepu8_epi32(_mm_srli_si128(c2, 8))),
+                      q3 = hsvComponent4<COMPONENT>(_mm_cvtepu8_epi32(_mm_srli_si128(c0, 12)),
+                                                    _mm_cvtepu8_epi32(_mm_srli_si128(c1, 12)),
+                                                    _mm_cvtepu8_epi32(_mm_srli_si128(c2, 12)));
+
+        // saturating packs, a hue of 256 becomes 255 like in OpenCV
+        return _mm_packus_epi16(_mm_packus_epi32(q0, q1), _mm_packus_epi32(q2, q3));
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::MINIMUM) {
+        return _mm_min_epu8(_mm_min_epu8(c0, c1), c2);
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::AVERAGE) {
+        // sum * 21846 >> 16 equals sum / 3 for all sums up to 765
+        const __m128i zero = _mm_setzero_si128(), third = _mm_set1_epi16(21846);
+
+        const __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(c0, zero), _mm_unpacklo_epi8(c1, zero)), _mm_unpacklo_epi8(c2, zero)),
+                      hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(c0, zero), _mm_unpackhi_epi8(c1, zero)), _mm_unpackhi_epi8(c2, zero));
+
+        return _mm_packus_epi16(_mm_mulhi_epu16(lo, third), _mm_mulhi_epu16(hi, third));
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::MAXIMUM || COMPONENT == image_proc::kernels::Component::VALUE) {
+        return _mm_max_epu8(_mm_max_epu8(c0, c1), c2);
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::CHANNEL_0) {
+        return c0;
+    } else if constexpr (COMPONENT == image_proc::kernels::Component::CHANNEL_1) {
+        return c1;
+    } else {
+        return c2;
+    }
+}
+
+/**
+ * Mask selecting the bytes of one channel within the block-th 16 bytes of interleaved pixels.
+*/
+static inline __m128i channelMask(int channel, int block) {
+    alignas(16) int8_t mask[16];
+    for (int i = 0; i < 16; i++) {
+        mask[i] = (block * 16 + i) % 3 == channel ? -1 : 0;
+    }
+
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+/**
+ * Channels kernel for one component and output channel (-1 for all).
+*/
+template <int COMPONENT, int OUTPUT_CHANNEL>
+static void channelsRowKernel(const uint8_t* src, uint8_t* dst, size_t width) {
+    const __m128i mask_a = channelMask(OUTPUT_CHANNEL, 0), mask_b = channelMask(OUTPUT_CHANNEL, 1), mask_c = channelMask(OUTPUT_CHANNEL, 2);
+
+    size_t x = 0ul;
+    for (; x + 16ul <= width; x += 16ul, src += 48, dst += 48) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)),
+                      b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16)),
+                      c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+
+        __m128i c0, c1, c2, out_a, out_b, out_c;
+        deinterleave(a, b, c, c0, c1, c2);
+        triplicate(componentValues<COMPONENT>(c0, c1, c2), out_a, out_b, out_c);
+
+        if constexpr (OUTPUT_CHANNEL >= 0) {
+            out_a = _mm_and_si128(out_a, mask_a);
+            out_b = _mm_and_si128(out_b, mask_b);
+            out_c = _mm_and_si128(out_c, mask_c);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),      out_a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), out_b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), out_c);
+    }
+
+    image_proc::kernels::scalar::channelsRow(src, dst, width - x, static_cast<image_proc::kernels::Component>(COMPONENT), OUTPUT_CHANNEL);
+}
+
+DEFINE_CHANNELS_ROW_KERNELS(channelsRowKernel);
+
+
+size_t image_proc::kernels::sse4::limitRow(const uint8_t* src, uint8_t* dst, size_t width, const uint8_t* lower, const uint8_t* upper) {
+    const __m128i lower0 = _mm_set1_epi8(lower[0]), upper0 = _mm_set1_epi8(upper[0]),
+                  lower1 = _mm_set1_epi8(lower[1]), upper1 = _mm_set1_epi8(upper[1]),
+                  lower2 = _mm_set1_epi8(lower[2]), upper2 = _mm_set1_epi8(upper[2]),
+                  zero   = _mm_setzero_si128();
+
+    size_t nr_in_range = 0ul, x = 0ul;
+    for (; x + 16ul <= width; x += 16ul, src += 48, dst += 48) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)),
+                      b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16)),
+                      c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+
+        __m128i c0, c1, c2;
+        deinterleave(a, b, c, c0, c1, c2);
+
+        const __m128i mask = _mm_and_si128(_mm_and_si128(inRange(c0, lower0, upper0), inRange(c1, lower1, upper1)),
+                                           inRange(c2, lower2, upper2));
+        const __m128i gray = _mm_packus_epi16(
+            gray8(_mm_unpacklo_epi8(c0, zero), _mm_unpacklo_epi8(c1, zero), _mm_unpacklo_epi8(c2, zero)),
+            gray8(_mm_unpackhi_epi8(c0, zero), _mm_unpackhi_epi8(c1, zero), _mm_unpackhi_epi8(c2, zero))
+        );
+        nr_in_range += __builtin_popcount(_mm_movemask_epi8(mask));
+
+        __m128i gray_a, gray_b, gray_c, mask_a, mask_b, mask_c;
+        triplicate(gray, gray_a, gray_b, gray_c);
+        triplicate(mask, mask_a, mask_b, mask_c);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst),      _mm_blendv_epi8(gray_a, a, mask_a));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_blendv_epi8(gray_b, b, mask_b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_blendv_epi8(gray_c, c, mask_c));
+    }
+
+    return nr_in_range + scalar::limitRow(src, dst, width - x, lower, upper);
+}
+
+void image_proc::kernels::sse4::channelsRow(const uint8_t* src, uint8_t* dst, size_t width, Component component, int output_channel) {
+    channels_row_kernels[component][output_channel + 1](src, dst, width);
+}
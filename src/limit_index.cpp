@@ -0,0 +1,200 @@
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <mutex>
+
+#include "limit_index.hpp"
+#include "tracer.hpp"
+
+
+/**
+ * Gray value of a pixel, the same as cv::COLOR_RGB2GRAY and the LIMIT kernels compute.
+*/
+static inline uint8_t grayValue(const uint8_t* pixel) {
+    return (pixel[0] * GRAY_WEIGHT_R + pixel[1] * GRAY_WEIGHT_G + pixel[2] * GRAY_WEIGHT_B + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT;
+}
+
+
+bool image_proc::LimitIndex::isBuiltFor(const cv::Mat& converted) const {
+    return !this->converted.empty() && this->converted.data == converted.data && this->converted.size() == converted.size();
+}
+
+void image_proc::LimitIndex::build(const cv::Mat& converted, const uint8_t* lower, const uint8_t* upper) {
+    TRACE_SCOPE("LimitIndex::build");
+
+    assert(converted.type() == CV_8UC3 && converted.isContinuous());
+
+    this->converted = converted;
+    this->output.create(converted.size(), CV_8UC3);
+    this->violations.resize(converted.total());
+    std::copy(lower, lower + NR_CHANNELS, this->lower);
+    std::copy(upper, upper + NR_CHANNELS, this->upper);
+
+    // counting sort of the pixel offsets by value, one channel per thread
+    const size_t nr_pixels = converted.total();
+    const uint8_t* data = converted.ptr<uint8_t>();
+    cv::parallel_for_(cv::Range(0, NR_CHANNELS), [&](const cv::Range& range) -> void {
+        for (int channel = range.start; channel < range.end; channel++) {
+            std::array<uint32_t, 257>& starts = this->bucket_starts[channel];
+            std::vector<uint32_t>& offsets = this->offsets[channel];
+
+            starts.fill(0u);
+            for (size_t i = 0ul; i < nr_pixels; i++) {
+                starts[data[i * NR_CHANNELS + channel] + 1]++;
+            }
+            for (size_t value = 1ul; value < starts.size(); value++) {
+                starts[value] += starts[value - 1ul];
+            }
+
+            std::array<uint32_t, 256> positions;
+            std::copy(starts.begin(), starts.end() - 1, positions.begin());
+            offsets.resize(nr_pixels);
+            for (size_t i = 0ul; i < nr_pixels; i++) {
+                offsets[positions[data[i * NR_CHANNELS + channel]]++] = static_cast<uint32_t>(i);
+            }
+        }
+    });
+
+    this->recompute();
+}
+
+size_t image_proc::LimitIndex::update(const uint8_t* lower, const uint8_t* upper) {
+    TRACE_SCOPE("LimitIndex::update");
+
+    // pixels to be visited per channel: values between the old and new bound
+    size_t nr_visits = 0ul;
+    for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+        const std::array<uint32_t, 257>& starts = this->bucket_starts[channel];
+
+        const int lower_first = std::min(lower[channel], this->lower[channel]),
+                  lower_last  = std::max(lower[channel], this->lower[channel]);
+        nr_visits += starts[lower_last] - starts[lower_first];
+
+        const int upper_first = std::min(upper[channel], this->upper[channel]) + 1,
+                  upper_last  = std::max(upper[channel], this->upper[channel]) + 1;
+        nr_visits += starts[upper_last] - starts[upper_first];
+    }
+
+    // random access per visited pixel is only worth it for a small part of the image
+    if (nr_visits > this->converted.total() / 4ul) {
+        std::copy(lower, lower + NR_CHANNELS, this->lower);
+        std::copy(upper, upper + NR_CHANNELS, this->upper);
+        this->recompute();
+
+        return this->converted.total();
+    }
+
+    for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+        // values below the lower bound violate it
+        if (lower[channel] > this->lower[channel]) {
+            this->updateBuckets(channel, this->lower[channel], lower[channel] - 1, true);
+        } else if (lower[channel] < this->lower[channel]) {
+            this->updateBuckets(channel, lower[channel], this->lower[channel] - 1, false);
+        }
+
+        // values above the upper bound violate it
+        if (upper[channel] < this->upper[channel]) {
+            this->updateBuckets(channel, upper[channel] + 1, this->upper[channel], true);
+        } else if (upper[channel] > this->upper[channel]) {
+            this->updateBuckets(channel, this->upper[channel] + 1, upper[channel], false);
+        }
+
+        this->lower[channel] = lower[channel];
+        this->upper[channel] = upper[channel];
+    }
+
+    return nr_visits;
+}
+
+image_proc::ImageStatistics image_proc::LimitIndex::getStatistics() const {
+    image_proc::ImageStatistics statistics;
+    statistics.nr_pixels   = this->converted.total();
+    statistics.nr_in_range = this->nr_in_range;
+    statistics.histograms  = this->histograms;
+
+    return statistics;
+}
+
+void image_proc::LimitIndex::recompute() {
+    const uint8_t* src = this->converted.ptr<uint8_t>();
+    uint8_t* dst = this->output.ptr<uint8_t>();
+    std::mutex mutex;
+
+    this->nr_in_range = 0ul;
+    for (std::array<uint64_t, 256>& histogram : this->histograms) {
+        histogram.fill(0ul);
+    }
+
+    cv::parallel_for_(cv::Range(0, static_cast<int>(this->converted.total())), [&](const cv::Range& range) -> void {
+        std::array<std::array<uint32_t, 256>, NR_CHANNELS> local_histograms {};
+        size_t local_in_range = 0ul;
+
+        for (int i = range.start; i < range.end; i++) {
+            const uint8_t* pixel = src + i * NR_CHANNELS;
+
+            uint8_t count = 0u;
+            for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+                count += pixel[channel] < this->lower[channel];
+                count += pixel[channel] > this->upper[channel];
+            }
+            this->violations[i] = count;
+
+            uint8_t* out = dst + i * NR_CHANNELS;
+            if (count) {
+                out[0] = out[1] = out[2] = grayValue(pixel);
+            } else {
+                out[0] = pixel[0]; out[1] = pixel[1]; out[2] = pixel[2];
+                local_in_range++;
+            }
+
+            for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+                local_histograms[channel][out[channel]]++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        this->nr_in_range += local_in_range;
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            for (size_t value = 0ul; value < 256ul; value++) {
+                this->histograms[channel][value] += local_histograms[channel][value];
+            }
+        }
+    }, PARALLEL_STRIPES);
+}
+
+void image_proc::LimitIndex::updateBuckets(size_t channel, int first, int last, bool add) {
+    const uint8_t* src = this->converted.ptr<uint8_t>();
+    uint8_t* dst = this->output.ptr<uint8_t>();
+
+    const std::vector<uint32_t>& offsets = this->offsets[channel];
+    const uint32_t begin = this->bucket_starts[channel][first],
+                   end   = this->bucket_starts[channel][last + 1];
+
+    for (uint32_t position = begin; position < end; position++) {
+        const uint32_t i = offsets[position];
+        const uint8_t* pixel = src + i * NR_CHANNELS;
+        uint8_t* out = dst + i * NR_CHANNELS;
+
+        if (add) {
+            if (this->violations[i]++ == 0u) {
+                const uint8_t gray = grayValue(pixel);
+
+                for (size_t c = 0ul; c < NR_CHANNELS; c++) {
+                    this->histograms[c][out[c]]--;
+                    this->histograms[c][gray]++;
+                }
+                out[0] = out[1] = out[2] = gray;
+                this->nr_in_range--;
+            }
+        } else {
+            if (--this->violations[i] == 0u) {
+                for (size_t c = 0ul; c < NR_CHANNELS; c++) {
+                    this->histograms[c][out[c]]--;
+                    this->histograms[c][pixel[c]]++;
+                }
+                out[0] = pixel[0]; out[1] = pixel[1]; out[2] = pixel[2];
+                this->nr_in_range++;
+            }
+        }
+    }
+}
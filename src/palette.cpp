@@ -0,0 +1,143 @@
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "palette.hpp"
+#include "tracer.hpp"
+
+
+bool image_proc::Palette::build(const cv::Mat& image) {
+    TRACE_SCOPE("Palette::build");
+
+    assert(image.type() == CV_8UC3);
+
+    this->source = image;
+    this->colors.release();
+    this->indices.release();
+    this->counts.clear();
+
+    if (image.empty()) {
+        return false;
+    }
+
+    // one bit per possible color (2MB), set bits are only written once to keep the cache lines shared
+    std::vector<std::atomic<uint64_t>> present(1ul << 18);
+    cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range& range) -> void {
+        for (int y = range.start; y < range.end; y++) {
+            const uint8_t* pixel = image.ptr<uint8_t>(y);
+
+            for (int x = 0; x < image.cols; x++, pixel += NR_CHANNELS) {
+                const uint32_t color = (pixel[0] << 16) | (pixel[1] << 8) | pixel[2];
+                const uint64_t bit = 1ull << (color & 63u);
+                std::atomic<uint64_t>& word = present[color >> 6];
+
+                if (!(word.load(std::memory_order_relaxed) & bit)) {
+                    word.fetch_or(bit, std::memory_order_relaxed);
+                }
+            }
+        }
+    });
+
+    // index of a color: number of set bits before it
+    std::vector<uint32_t> ranks(present.size());
+    uint32_t nr_colors = 0u;
+    for (size_t i = 0ul; i < present.size(); i++) {
+        ranks[i] = nr_colors;
+        nr_colors += __builtin_popcountll(present[i].load(std::memory_order_relaxed));
+    }
+
+    if (nr_colors > std::min(PALETTE_MAX_COLORS, image.total() / PALETTE_MIN_COMPACTION)) {
+        return false;
+    }
+
+    this->colors.create(1, nr_colors, CV_8UC3);
+    uint8_t* color = this->colors.ptr<uint8_t>();
+    for (size_t i = 0ul; i < present.size(); i++) {
+        for (uint64_t bits = present[i].load(std::memory_order_relaxed); bits; bits &= bits - 1ull) {
+            const uint32_t value = (i << 6) | __builtin_ctzll(bits);
+
+            color[0] = value >> 16; color[1] = value >> 8; color[2] = value;
+            color += NR_CHANNELS;
+        }
+    }
+
+    // pixels per color, counted per range and merged afterwards
+    this->indices.create(image.size(), CV_16UC1);
+    this->counts.assign(nr_colors, 0u);
+    std::mutex mutex;
+    cv::parallel_for_(cv::Range(0, image.rows), [&](const cv::Range& range) -> void {
+        std::vector<uint32_t> local_counts(nr_colors, 0u);
+
+        for (int y = range.start; y < range.end; y++) {
+            const uint8_t* pixel = image.ptr<uint8_t>(y);
+            uint16_t* index = this->indices.ptr<uint16_t>(y);
+
+            for (int x = 0; x < image.cols; x++, pixel += NR_CHANNELS) {
+                const uint32_t color = (pixel[0] << 16) | (pixel[1] << 8) | pixel[2];
+                const uint64_t below = present[color >> 6].load(std::memory_order_relaxed) & ((1ull << (color & 63u)) - 1ull);
+
+                index[x] = ranks[color >> 6] + __builtin_popcountll(below);
+                local_counts[index[x]]++;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (uint32_t i = 0u; i < nr_colors; i++) {
+            this->counts[i] += local_counts[i];
+        }
+    }, PARALLEL_STRIPES);
+
+    return true;
+}
+
+bool image_proc::Palette::isBuiltFor(const cv::Mat& image) const {
+    return !this->source.empty() && this->source.data == image.data && this->source.size() == image.size();
+}
+
+void image_proc::Palette::apply(const cv::Mat& colors, cv::Mat& dst) const {
+    TRACE_SCOPE("Palette::apply");
+
+    assert(colors.type() == CV_8UC3 && colors.total() == this->colors.total());
+
+    dst.create(this->indices.size(), CV_8UC3);
+
+    const uint8_t* color = colors.ptr<uint8_t>();
+    cv::parallel_for_(cv::Range(0, this->indices.rows), [&](const cv::Range& range) -> void {
+        for (int y = range.start; y < range.end; y++) {
+            const uint16_t* index = this->indices.ptr<uint16_t>(y);
+            uint8_t* pixel = dst.ptr<uint8_t>(y);
+
+            for (int x = 0; x < this->indices.cols; x++, pixel += NR_CHANNELS) {
+                const uint8_t* value = color + index[x] * NR_CHANNELS;
+
+                pixel[0] = value[0]; pixel[1] = value[1]; pixel[2] = value[2];
+            }
+        }
+    });
+}
+
+void image_proc::Palette::getStatistics(const cv::Mat& colors, ImageStatistics& statistics, const cv::Mat& in_range) const {
+    assert(colors.type() == CV_8UC3 && colors.total() == this->counts.size());
+    assert(in_range.empty() || (in_range.type() == CV_8UC1 && in_range.total() == this->counts.size()));
+
+    statistics = ImageStatistics();
+    statistics.nr_pixels = this->source.total();
+
+    const uint8_t* color = colors.ptr<uint8_t>();
+    for (size_t i = 0ul; i < this->counts.size(); i++, color += NR_CHANNELS) {
+        for (size_t channel = 0ul; channel < NR_CHANNELS; channel++) {
+            statistics.histograms[channel][color[channel]] += this->counts[i];
+        }
+
+        if (!in_range.empty() && in_range.ptr<uint8_t>()[i]) {
+            statistics.nr_in_range += this->counts[i];
+        }
+    }
+}
+
+double image_proc::Palette::getCompactionRatio() const {
+    return this->colors.empty() ? 0.0 : static_cast<double>(this->source.total()) / this->colors.total();
+}
@@ -0,0 +1,278 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "raw_image_cache.hpp"
+#include "tracer.hpp"
+
+
+// page sized, so the pixels behind it stay page aligned in the mapping
+#define RAW_HEADER_SIZE 4096ul
+#define RAW_MAGIC       "IMRAW01"
+
+/**
+ * Fixed part of an entry header, the canonical source path follows it (null terminated).
+*/
+struct RawHeader {
+    char     magic[8];
+    int32_t  rows, cols, type;
+    uint64_t step;
+    int64_t  source_time;
+    uint64_t source_size;
+};
+
+/**
+ * Mat allocator owning the read-only mappings of cache entries.
+*/
+class MappingAllocator: public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(int /*dims*/, const int* /*sizes*/, int /*type*/, void* /*data*/, size_t* /*step*/,
+                               cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+            // mappings are only ever attached by RawImageCache::load
+            return nullptr;
+        }
+
+        bool allocate(cv::UMatData* /*u*/, cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+            return false;
+        }
+
+        void deallocate(cv::UMatData* u) const override {
+            if (!u) {
+                return;
+            }
+
+            munmap(u->origdata, RAW_HEADER_SIZE + u->size);
+            delete u;
+        }
+};
+
+/**
+ * Return the allocator of all mappings. It is never destroyed, so images may outlive their cache.
+ *
+ * @return the allocator
+*/
+cv::MatAllocator* getMappingAllocator() {
+    static MappingAllocator* allocator = new MappingAllocator();
+
+    return allocator;
+}
+
+
+image_proc::RawImageCache::RawImageCache(const std::string& directory, size_t size_limit):
+    size_limit(size_limit) {
+
+    if (!directory.empty()) {
+        this->directory = directory;
+    } else if (const char* cache_home = std::getenv("XDG_CACHE_HOME"); cache_home && *cache_home) {
+        this->directory = std::filesystem::path(cache_home) / "image_manipulator";
+    } else if (const char* home = std::getenv("HOME"); home && *home) {
+        this->directory = std::filesystem::path(home) / ".cache" / "image_manipulator";
+    } else {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+        std::cerr << "Unable to create raw image cache " << this->directory << ": " << error.message() << std::endl;
+
+        return;
+    }
+
+    this->usable = true;
+}
+
+bool image_proc::RawImageCache::load(cv::Mat& image, const std::string& filepath) {
+    TRACE_SCOPE("RawImageCache::load");
+
+    std::string canonical;
+    int64_t source_time;
+    uint64_t source_size;
+    const std::filesystem::path entry = this->entryPath(filepath, canonical, source_time, source_size);
+    if (entry.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    const int fd = open(entry.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    RawHeader header;
+    char stored_path[RAW_HEADER_SIZE - sizeof(RawHeader)];
+    const bool header_read = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+                          && pread(fd, stored_path, sizeof(stored_path), sizeof(header)) == sizeof(stored_path);
+
+    // a hash collision or an entry written by a different version is simply a miss
+    const size_t data_size = header_read ? header.step * header.rows : 0ul;
+    if (!header_read || std::memcmp(header.magic, RAW_MAGIC, sizeof(header.magic))
+        || header.source_time != source_time || header.source_size != source_size
+        || std::strncmp(stored_path, canonical.c_str(), sizeof(stored_path)) || header.type != CV_8UC3
+        || static_cast<uint64_t>(lseek(fd, 0, SEEK_END)) != RAW_HEADER_SIZE + data_size) {
+        close(fd);
+
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, RAW_HEADER_SIZE + data_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    // header of the mapped pixels that unmaps them once the last reference is released
+    uchar* data = static_cast<uchar*>(mapping) + RAW_HEADER_SIZE;
+    cv::Mat mapped(header.rows, header.cols, header.type, data, header.step);
+
+    cv::UMatData* u = new cv::UMatData(getMappingAllocator());
+    u->data = data;
+    u->origdata = static_cast<uchar*>(mapping);
+    u->size = data_size;
+    u->refcount = 1;
+    mapped.u = u;
+    mapped.allocator = getMappingAllocator();
+
+    image = mapped;
+
+    // the modification time of an entry is its last use
+    std::error_code error;
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+
+    return true;
+}
+
+bool image_proc::RawImageCache::store(const cv::Mat& image, const std::string& filepath) {
+    TRACE_SCOPE("RawImageCache::store");
+
+    assert(image.type() == CV_8UC3);
+
+    std::string canonical;
+    int64_t source_time;
+    uint64_t source_size;
+    const std::filesystem::path entry = this->entryPath(filepath, canonical, source_time, source_size);
+
+    const size_t data_size = image.step[0] * image.rows;
+    if (entry.empty() || !image.isContinuous() || canonical.size() >= RAW_HEADER_SIZE - sizeof(RawHeader)
+        || data_size > this->size_limit) {
+        return false;
+    }
+
+    std::vector<char> header_page(RAW_HEADER_SIZE, '\0');
+    RawHeader header;
+    std::memcpy(header.magic, RAW_MAGIC, sizeof(header.magic));
+    header.rows        = image.rows;
+    header.cols        = image.cols;
+    header.type        = image.type();
+    header.step        = image.step[0];
+    header.source_time = source_time;
+    header.source_size = source_size;
+    std::memcpy(header_page.data(), &header, sizeof(header));
+    std::memcpy(header_page.data() + sizeof(header), canonical.c_str(), canonical.size());
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    // written under another name first, so a crash never leaves a truncated entry behind
+    const std::filesystem::path temp_path = entry.string() + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(header_page.data(), header_page.size());
+        file.write(reinterpret_cast<const char*>(image.data), data_size);
+
+        if (!file) {
+            std::error_code error;
+            std::filesystem::remove(temp_path, error);
+            std::cerr << "Unable to write raw image cache entry " << temp_path << std::endl;
+
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, entry, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+
+        return false;
+    }
+
+    this->evict();
+
+    return true;
+}
+
+std::filesystem::path image_proc::RawImageCache::entryPath(const std::string& filepath, std::string& canonical, int64_t& source_time, uint64_t& source_size) const {
+    if (!this->usable) {
+        return std::filesystem::path();
+    }
+
+    std::error_code error;
+    canonical = std::filesystem::canonical(filepath, error).string();
+    if (error) {
+        return std::filesystem::path();
+    }
+
+    source_time = std::filesystem::last_write_time(canonical, error).time_since_epoch().count();
+    if (error) {
+        return std::filesystem::path();
+    }
+    source_size = std::filesystem::file_size(canonical, error);
+    if (error) {
+        return std::filesystem::path();
+    }
+
+    // the key is only a hash, the header holds the full key to tell collisions apart
+    char name[64];
+    const size_t hash = std::hash<std::string>()(canonical + '\n' + std::to_string(source_time) + '\n' + std::to_string(source_size));
+    std::snprintf(name, sizeof(name), "%016zx.rgb", hash);
+
+    return this->directory / name;
+}
+
+void image_proc::RawImageCache::evict() {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uintmax_t size;
+    };
+
+    std::vector<Entry> entries;
+    uintmax_t total_size = 0u;
+
+    std::error_code error;
+    for (const std::filesystem::directory_entry& file: std::filesystem::directory_iterator(this->directory, error)) {
+        if (file.path().extension() != ".rgb") {
+            continue;
+        }
+
+        Entry entry {file.path(), file.last_write_time(error), file.file_size(error)};
+        if (!error) {
+            entries.push_back(entry);
+            total_size += entry.size;
+        }
+    }
+
+    // oldest use first
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {return a.last_used < b.last_used;});
+
+    // mapped entries stay readable after removal, the space is freed once they get unmapped
+    for (const Entry& entry: entries) {
+        if (total_size <= this->size_limit) {
+            break;
+        }
+
+        if (std::filesystem::remove(entry.path, error)) {
+            total_size -= entry.size;
+        }
+    }
+}
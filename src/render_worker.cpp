@@ -0,0 +1,159 @@
+#include <opencv2/imgproc.hpp>
+
+#include "render_worker.hpp"
+#include "tracer.hpp"
+
+
+RenderWorker::RenderWorker(const std::array<image_proc::ConversionCache*, 2>& conversion_caches, image_proc::ScratchArena* scratch_arena):
+    pipeline(conversion_caches[0], scratch_arena, true),
+    preview_pipeline(conversion_caches[1], scratch_arena, false),
+    conversion_cache(conversion_caches[0]),
+    proxy_conversion_cache(conversion_caches[1]),
+    scratch_arena(scratch_arena),
+    thread(&RenderWorker::work, this) {}
+
+RenderWorker::~RenderWorker() {
+    {
+        std::lock_guard<std::mutex> lock(this->request_mutex);
+        this->stopping = true;
+    }
+    this->request_condition.notify_one();
+    this->thread.join();
+
+    delete this->finished_frame.exchange(nullptr);
+}
+
+uint64_t RenderWorker::request(const cv::Mat& source, const image_proc::EditParameters& parameters, const cv::Size& preview_size, const cv::Rect& viewport) {
+    std::unique_ptr<Request> request(new Request {0u, preview_size, source, parameters, viewport});
+    uint64_t generation;
+
+    {
+        std::lock_guard<std::mutex> lock(this->request_mutex);
+        generation = request->generation = ++this->next_generation;
+
+        // an older request that did not start yet is simply replaced
+        this->pending_request = std::move(request);
+    }
+    this->request_condition.notify_one();
+
+    return generation;
+}
+
+std::unique_ptr<RenderWorker::Frame> RenderWorker::takeFrame() {
+    return std::unique_ptr<Frame>(this->finished_frame.exchange(nullptr));
+}
+
+void RenderWorker::work() {
+    while (true) {
+        std::unique_ptr<Request> request;
+        {
+            std::unique_lock<std::mutex> lock(this->request_mutex);
+            this->request_condition.wait(lock, [this]() {return this->stopping || this->pending_request;});
+
+            if (this->stopping) {
+                return;
+            }
+
+            request = std::move(this->pending_request);
+        }
+
+        // the proxy of an old image is no use anymore, neither is the old image it holds on to
+        if (request->source.data != this->proxy_source.data) {
+            this->proxy_source.release();
+            this->proxy.release();
+        }
+
+        if (!request->preview_size.empty()) {
+            this->publish(this->renderPreview(*request));
+
+            // a proxy of another size (zoom or window size changed) only gets built while nothing newer is waiting
+            if (this->proxy.size() != request->preview_size && !this->hasNewerRequest()) {
+                TRACE_SCOPE("RenderWorker::resizeProxy");
+
+                // assign a new image, the preview pipeline still holds on to the old proxy
+                cv::Mat proxy;
+                cv::resize(request->source, proxy, request->preview_size, 0.0, 0.0, cv::INTER_AREA);
+                this->proxy = proxy;
+                this->proxy_conversion_cache->setSource(this->proxy);
+            }
+            continue;
+        }
+
+        // tiles only pay off while the pipeline would have to edit every pixel again
+        if (request->viewport.area() > 0 && !this->pipeline.isWarm(request->source, request->parameters)) {
+            std::unique_ptr<Frame> frame = this->renderTiled(*request);
+            if (!frame) {
+                continue;
+            }
+            this->publish(std::move(frame));
+
+            // palette and limit index make the following edits of this image incremental,
+            // preparing them stops as soon as a newer request arrives
+            this->pipeline.warmUp(request->source, request->parameters, [this]() -> bool {return this->hasNewerRequest();});
+            continue;
+        }
+
+        std::unique_ptr<Frame> frame(new Frame {request->generation, false, cv::Rect(), cv::Mat(), image_proc::ImageStatistics()});
+        this->pipeline.render(request->source, request->parameters, frame->image, frame->statistics);
+
+        this->publish(std::move(frame));
+    }
+}
+
+std::unique_ptr<RenderWorker::Frame> RenderWorker::renderPreview(const Request& request) {
+    TRACE_SCOPE("RenderWorker::renderPreview");
+
+    // only the first preview of an image waits for its proxy, later ones render from whatever proxy there is
+    if (this->proxy.empty()) {
+        cv::resize(request.source, this->proxy, request.preview_size, 0.0, 0.0, cv::INTER_AREA);
+        this->proxy_source = request.source;
+        this->proxy_conversion_cache->setSource(this->proxy);
+    }
+
+    std::unique_ptr<Frame> frame(new Frame {request.generation, true, cv::Rect(), cv::Mat(), image_proc::ImageStatistics()});
+    this->preview_pipeline.render(this->proxy, request.parameters, frame->image, frame->statistics);
+
+    return frame;
+}
+
+std::unique_ptr<RenderWorker::Frame> RenderWorker::renderTiled(const Request& request) {
+    TRACE_SCOPE("RenderWorker::renderTiled");
+
+    // converting the whole image first would make the visible tiles wait for it, uncached they convert their own pixels
+    cv::Mat converted;
+    const bool limit = request.parameters.mode == image_proc::EditMode::LIMIT;
+    if (limit) {
+        converted = this->conversion_cache->tryGet(request.source, request.parameters.color_space);
+    }
+
+    // the visible tiles first, they only carry the region they cover
+    std::unique_ptr<Frame> visible(new Frame {request.generation, false, cv::Rect(), cv::Mat(), image_proc::ImageStatistics()});
+    visible->region = this->tile_renderer.renderVisible(request.source, converted, request.parameters, request.viewport, visible->image);
+    this->publish(std::move(visible));
+
+    // later edits in this color space get the whole conversion from the cache
+    if (limit && converted.empty()) {
+        this->conversion_cache->prefetch(request.parameters.color_space);
+    }
+
+    // the rest only while nothing newer is waiting, tiles done so far stay cached for the next request
+    std::unique_ptr<Frame> frame(new Frame {request.generation, false, cv::Rect(), cv::Mat(), image_proc::ImageStatistics()});
+    frame->image = this->scratch_arena->acquire(request.source.size(), CV_8UC3);
+    if (!this->tile_renderer.renderAll(request.source, converted, request.parameters, request.viewport, frame->image, frame->statistics,
+                                       [this]() -> bool {return this->hasNewerRequest();})) {
+        return nullptr;
+    }
+
+    return frame;
+}
+
+bool RenderWorker::hasNewerRequest() {
+    std::lock_guard<std::mutex> lock(this->request_mutex);
+    return this->stopping || this->pending_request;
+}
+
+void RenderWorker::publish(std::unique_ptr<Frame> frame) {
+    // a frame the main loop did not take yet is outdated now
+    delete this->finished_frame.exchange(frame.release());
+    this->frame_ready.emit();
+}
@@ -0,0 +1,130 @@
+#include <cstdlib>
+#include <sys/mman.h>
+
+#include "scratch_arena.hpp"
+
+
+/**
+ * Mat allocator handing out SCRATCH_ALIGNMENT aligned memory, huge page aligned and advised for large buffers.
+*/
+class AlignedAllocator: public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                               cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+            size_t total = CV_ELEM_SIZE(type);
+            for (int i = dims - 1; i >= 0; i--) {
+                if (step) {
+                    if (data && step[i] != CV_AUTOSTEP) {
+                        total = step[i];
+                    } else {
+                        step[i] = total;
+                    }
+                }
+                total *= sizes[i];
+            }
+
+            cv::UMatData* u = new cv::UMatData(this);
+            u->size = total;
+            if (data) {
+                u->data = u->origdata = static_cast<uchar*>(data);
+                u->flags |= cv::UMatData::USER_ALLOCATED;
+
+                return u;
+            }
+
+            // aligned_alloc wants the size to be a multiple of the alignment
+            const size_t alignment = total >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : SCRATCH_ALIGNMENT;
+            const size_t bytes = (total + alignment - 1ul) / alignment * alignment;
+
+            u->data = u->origdata = static_cast<uchar*>(std::aligned_alloc(alignment, bytes));
+            if (!u->data) {
+                delete u;
+                CV_Error(cv::Error::StsNoMem, "Unable to allocate scratch buffer");
+            }
+
+#ifdef MADV_HUGEPAGE
+            if (alignment == HUGE_PAGE_SIZE) {
+                madvise(u->data, bytes, MADV_HUGEPAGE);
+            }
+#endif
+
+            return u;
+        }
+
+        bool allocate(cv::UMatData* u, cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+            return u != nullptr;
+        }
+
+        void deallocate(cv::UMatData* u) const override {
+            if (!u) {
+                return;
+            }
+
+            if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+                std::free(u->origdata);
+            }
+            delete u;
+        }
+};
+
+/**
+ * Return the allocator used for all scratch buffers. It is never destroyed, so buffers may outlive their arena.
+ *
+ * @return the allocator
+*/
+cv::MatAllocator* getAlignedAllocator() {
+    static AlignedAllocator* allocator = new AlignedAllocator();
+
+    return allocator;
+}
+
+
+cv::Mat image_proc::ScratchArena::acquire(const cv::Size& size, int type) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    // a reference count of one means only the arena still holds the buffer
+    for (const cv::Mat& buffer: this->buffers) {
+        if (buffer.size() == size && buffer.type() == type && CV_XADD(&buffer.u->refcount, 0) == 1) {
+            return buffer;
+        }
+    }
+
+    cv::Mat buffer;
+    buffer.allocator = getAlignedAllocator();
+    buffer.create(size, type);
+
+    this->buffers.push_back(buffer);
+    this->nr_allocations++;
+
+    return buffer;
+}
+
+void image_proc::ScratchArena::trim() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    std::vector<cv::Mat> in_use;
+    for (const cv::Mat& buffer: this->buffers) {
+        if (CV_XADD(&buffer.u->refcount, 0) > 1) {
+            in_use.push_back(buffer);
+        }
+    }
+
+    this->buffers = std::move(in_use);
+}
+
+size_t image_proc::ScratchArena::getAllocationCount() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    return this->nr_allocations;
+}
+
+size_t image_proc::ScratchArena::getBytes() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    size_t bytes = 0ul;
+    for (const cv::Mat& buffer: this->buffers) {
+        bytes += buffer.u->size;
+    }
+
+    return bytes;
+}
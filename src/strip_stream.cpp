@@ -0,0 +1,166 @@
+#include <opencv2/core/utility.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <limits>
+
+#include "strip_stream.hpp"
+#include "tracer.hpp"
+
+
+#define MAX_8BIT 0xFF
+
+
+/**
+ * Read the next header number of a PPM, skipping whitespace and comments.
+ *
+ * @param file: the opened file
+ * @param value: output number
+ * @return wether or not a number was read
+*/
+bool readPpmNumber(std::ifstream& file, int& value) {
+    while (file) {
+        const int c = file.peek();
+
+        if (c == '#') {
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        } else if (std::isspace(c)) {
+            file.get();
+        } else {
+            break;
+        }
+    }
+
+    return static_cast<bool>(file >> value);
+}
+
+
+bool image_proc::PpmReader::open(const std::string& filepath) {
+    this->file.open(filepath, std::ios::binary);
+    this->next_row = 0;
+
+    char magic[2];
+    int width, height, max_value;
+    if (!this->file.read(magic, 2) || magic[0] != 'P' || magic[1] != '6'
+        || !readPpmNumber(this->file, width) || !readPpmNumber(this->file, height) || !readPpmNumber(this->file, max_value)
+        || width <= 0 || height <= 0 || max_value != MAX_8BIT) {
+        return false;
+    }
+
+    // a single whitespace separates the header from the pixels
+    this->file.get();
+    this->size = cv::Size(width, height);
+
+    return static_cast<bool>(this->file);
+}
+
+int image_proc::PpmReader::read(cv::Mat& buffer) {
+    assert(buffer.type() == CV_8UC3 && buffer.isContinuous() && buffer.cols == this->size.width);
+
+    const int rows = std::min(buffer.rows, this->size.height - this->next_row);
+    if (rows <= 0) {
+        return 0;
+    }
+
+    if (!this->file.read(buffer.ptr<char>(), static_cast<std::streamsize>(rows) * buffer.step[0])) {
+        return -1;
+    }
+    this->next_row += rows;
+
+    return rows;
+}
+
+
+bool image_proc::PpmWriter::open(const std::string& filepath, const cv::Size& size) {
+    this->file.open(filepath, std::ios::binary | std::ios::trunc);
+    this->size = size;
+    this->next_row = 0;
+
+    this->file << "P6\n" << size.width << ' ' << size.height << '\n' << MAX_8BIT << '\n';
+
+    return static_cast<bool>(this->file);
+}
+
+bool image_proc::PpmWriter::write(const cv::Mat& strip) {
+    assert(strip.type() == CV_8UC3 && strip.cols == this->size.width);
+
+    if (this->next_row + strip.rows > this->size.height) {
+        return false;
+    }
+
+    for (int y = 0; y < strip.rows; y++) {
+        this->file.write(strip.ptr<char>(y), strip.cols * NR_CHANNELS);
+    }
+    this->next_row += strip.rows;
+
+    return static_cast<bool>(this->file);
+}
+
+bool image_proc::PpmWriter::close() {
+    this->file.close();
+
+    return this->file && this->next_row == this->size.height;
+}
+
+
+bool image_proc::streamEdits(const std::string& input_path, const std::string& output_path, const EditParameters& parameters,
+                             size_t memory_budget, StreamSummary* summary) {
+    TRACE_SCOPE("streamEdits");
+
+    PpmReader reader;
+    if (!reader.open(input_path)) {
+        std::cerr << "Unable to read " << input_path << " as binary 8bit PPM" << std::endl;
+
+        return false;
+    }
+    const cv::Size size = reader.getSize();
+
+    // an input and an output strip, plus the conversion strip every thread keeps for LIMIT edits
+    const size_t row_bytes = size.width * NR_CHANNELS;
+    const size_t conversion_bytes = cv::getNumThreads() * std::max(static_cast<size_t>(LIMIT_STRIP_BYTES), row_bytes);
+    if (memory_budget < conversion_bytes + 2ul * row_bytes) {
+        std::cerr << "Unable to stream " << input_path << ": a memory budget of " << memory_budget
+                  << " bytes does not even hold a single row (" << conversion_bytes + 2ul * row_bytes << " bytes)" << std::endl;
+
+        return false;
+    }
+    const int strip_rows = static_cast<int>(std::min<size_t>((memory_budget - conversion_bytes) / (2ul * row_bytes), size.height));
+
+    PpmWriter writer;
+    if (!writer.open(output_path, size)) {
+        std::cerr << "Unable to write " << output_path << std::endl;
+
+        return false;
+    }
+
+    cv::Mat input(strip_rows, size.width, CV_8UC3), output(strip_rows, size.width, CV_8UC3);
+    ImageStatistics statistics, strip_statistics;
+
+    for (int rows = reader.read(input); rows > 0; rows = reader.read(input)) {
+        // headers of the filled part, applyEdits writes into the output buffer since size and type match
+        cv::Mat output_strip = output.rowRange(0, rows);
+        image_proc::applyEdits(input.rowRange(0, rows), output_strip, parameters, cv::Mat(), &strip_statistics);
+        statistics.add(strip_statistics);
+
+        if (!writer.write(output_strip)) {
+            std::cerr << "Unable to write " << output_path << std::endl;
+
+            return false;
+        }
+    }
+
+    if (!writer.close()) {
+        std::cerr << "Unable to process " << input_path << " completely (truncated input or full disk)" << std::endl;
+
+        return false;
+    }
+
+    if (summary) {
+        summary->strip_rows   = strip_rows;
+        summary->buffer_bytes = 2ul * strip_rows * row_bytes + conversion_bytes;
+        summary->statistics   = statistics;
+    }
+
+    return true;
+}
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <functional>
+
+#include "tile_renderer.hpp"
+#include "tracer.hpp"
+
+
+image_proc::TileRenderer::TileRenderer(size_t cache_budget):
+    cache_budget(cache_budget) {}
+
+cv::Rect image_proc::TileRenderer::renderVisible(const cv::Mat& source, const cv::Mat& converted, const EditParameters& parameters,
+                                                  const cv::Rect& viewport, cv::Mat& region_image) {
+    TRACE_SCOPE("TileRenderer::renderVisible");
+
+    this->setSource(source);
+
+    size_t nr_visible = 0ul;
+    const std::vector<int> order = this->getTileOrder(viewport, nr_visible);
+    const EditKey edit_key = getEditKey(parameters);
+
+    cv::Rect region;
+    for (size_t i = 0ul; i < nr_visible; i++) {
+        region |= this->getTileRect(order[i]);
+    }
+
+    region_image.create(region.size(), CV_8UC3);
+    for (size_t i = 0ul; i < nr_visible; i++) {
+        const Tile& tile = this->getTile(converted, parameters, edit_key, order[i]);
+        const cv::Rect rect = this->getTileRect(order[i]);
+
+        cv::Mat target = region_image(rect - region.tl());
+        image_proc::compressImage(tile.image, target, parameters.compression_level);
+    }
+
+    return region;
+}
+
+bool image_proc::TileRenderer::renderAll(const cv::Mat& source, const cv::Mat& converted, const EditParameters& parameters, const cv::Rect& viewport,
+                                         cv::Mat& image, ImageStatistics& statistics, const std::function<bool()>& cancelled) {
+    TRACE_SCOPE("TileRenderer::renderAll");
+
+    this->setSource(source);
+
+    size_t nr_visible = 0ul;
+    const std::vector<int> order = this->getTileOrder(viewport, nr_visible);
+    const EditKey edit_key = getEditKey(parameters);
+
+    image.create(source.size(), CV_8UC3);
+    statistics = ImageStatistics();
+
+    for (int index: order) {
+        if (cancelled && cancelled()) {
+            return false;
+        }
+
+        // the tile may get evicted by the next one, so it is compressed into the image right away
+        const Tile& tile = this->getTile(converted, parameters, edit_key, index);
+        cv::Mat target = image(this->getTileRect(index));
+        image_proc::compressImage(tile.image, target, parameters.compression_level);
+        statistics.add(tile.statistics);
+    }
+
+    // the histograms of the uncompressed tiles only get remapped, no pass over the pixels
+    if (parameters.compression_level != 8.0) {
+        statistics.compress(image_proc::getCompressionTable(parameters.compression_level));
+    }
+
+    return true;
+}
+
+void image_proc::TileRenderer::setSource(const cv::Mat& source) {
+    if (source.data == this->source.data && source.size() == this->source.size()) {
+        return;
+    }
+
+    this->source   = source;
+    this->nr_tiles = cv::Size((source.cols + TILE_SIZE - 1) / TILE_SIZE, (source.rows + TILE_SIZE - 1) / TILE_SIZE);
+
+    this->tiles.clear();
+    this->tile_lookup.clear();
+    this->cache_bytes = 0ul;
+}
+
+std::vector<int> image_proc::TileRenderer::getTileOrder(const cv::Rect& viewport, size_t& nr_visible) const {
+    const cv::Rect visible = viewport & cv::Rect(cv::Point(), this->source.size());
+    const cv::Rect around = visible.area() > 0 ? visible : cv::Rect(cv::Point(), this->source.size());
+    const cv::Point2d center(around.x + around.width * 0.5, around.y + around.height * 0.5);
+
+    std::vector<int> order(this->nr_tiles.area());
+    std::vector<double> distances(order.size());
+    for (int index = 0; index < static_cast<int>(order.size()); index++) {
+        const cv::Rect rect = this->getTileRect(index);
+        const cv::Point2d tile_center(rect.x + rect.width * 0.5, rect.y + rect.height * 0.5);
+
+        order[index]     = index;
+        distances[index] = cv::norm(tile_center - center);
+    }
+
+    // within the viewport first, then nearest to its center first
+    const auto is_visible = [this, &visible](int index) -> bool {
+        return (this->getTileRect(index) & visible).area() > 0;
+    };
+    const auto visible_end = std::stable_partition(order.begin(), order.end(), is_visible);
+
+    const auto nearer = [&distances](int a, int b) -> bool {
+        return distances[a] < distances[b];
+    };
+    std::sort(order.begin(), visible_end, nearer);
+    std::sort(visible_end, order.end(), nearer);
+
+    nr_visible = visible_end - order.begin();
+    return order;
+}
+
+cv::Rect image_proc::TileRenderer::getTileRect(int index) const {
+    const int x = (index % this->nr_tiles.width) * TILE_SIZE,
+              y = (index / this->nr_tiles.width) * TILE_SIZE;
+
+    return cv::Rect(x, y, std::min(TILE_SIZE, this->source.cols - x), std::min(TILE_SIZE, this->source.rows - y));
+}
+
+image_proc::TileRenderer::EditKey image_proc::TileRenderer::getEditKey(const EditParameters& parameters) {
+    EditKey edit_key {};
+    edit_key[0] = parameters.mode;
+
+    if (parameters.mode == image_proc::EditMode::LIMIT) {
+        // the bounds are applied as 8bit values, fractions in between do not change the result
+        edit_key[1] = parameters.color_space;
+        for (size_t i = 0ul; i < 2ul * NR_CHANNELS; i++) {
+            edit_key[i + 2ul] = cv::saturate_cast<uint8_t>(parameters.limits[i]);
+        }
+    } else {
+        edit_key[1] = parameters.modifier;
+        edit_key[2] = parameters.channel;
+    }
+
+    return edit_key;
+}
+
+const image_proc::TileRenderer::Tile& image_proc::TileRenderer::getTile(const cv::Mat& converted, const EditParameters& parameters,
+                                                                         const EditKey& edit_key, int index) {
+    const TileKey key(edit_key, index);
+
+    const auto found = this->tile_lookup.find(key);
+    if (found != this->tile_lookup.end()) {
+        this->tiles.splice(this->tiles.begin(), this->tiles, found->second);
+        return this->tiles.front();
+    }
+
+    TRACE_SCOPE("TileRenderer::renderTile");
+
+    const cv::Rect rect = this->getTileRect(index);
+
+    EditParameters uncompressed = parameters;
+    uncompressed.compression_level = 8.0;
+
+    Tile tile;
+    tile.key = key;
+    image_proc::applyEdits(this->source(rect), tile.image, uncompressed, converted.empty() ? cv::Mat() : converted(rect), &tile.statistics);
+    this->nr_rendered_tiles++;
+
+    const size_t tile_bytes = tile.image.total() * tile.image.elemSize() + sizeof(Tile);
+
+    // least recently used tiles go first, the new one always stays
+    while (!this->tiles.empty() && this->cache_bytes + tile_bytes > this->cache_budget) {
+        const Tile& evicted = this->tiles.back();
+
+        this->cache_bytes -= evicted.image.total() * evicted.image.elemSize() + sizeof(Tile);
+        this->tile_lookup.erase(evicted.key);
+        this->tiles.pop_back();
+    }
+
+    this->tiles.push_front(std::move(tile));
+    this->tile_lookup[key] = this->tiles.begin();
+    this->cache_bytes += tile_bytes;
+
+    return this->tiles.front();
+}
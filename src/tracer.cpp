@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "tracer.hpp"
+
+
+/**
+ * Return the p-th percentile of some durations (nearest rank).
+ *
+ * @param durations: the durations, get reordered
+ * @param percentile: wanted percentile from 0.0 to 1.0
+ * @return the percentile in milliseconds
+*/
+double getPercentile(std::vector<float>& durations, double percentile) {
+    const size_t rank = std::min(durations.size() - 1ul, static_cast<size_t>(percentile * durations.size()));
+    std::nth_element(durations.begin(), durations.begin() + rank, durations.end());
+
+    return durations[rank];
+}
+
+
+image_proc::Tracer& image_proc::Tracer::get() {
+    static Tracer tracer;
+
+    return tracer;
+}
+
+image_proc::Tracer::Tracer():
+    epoch(Clock::now()) {
+
+    if (const char* filepath = std::getenv("IMAGE_MANIPULATOR_TRACE"); filepath && *filepath) {
+        this->enable(filepath);
+    }
+}
+
+image_proc::Tracer::~Tracer() {
+    if (this->isEnabled()) {
+        this->write();
+    }
+}
+
+void image_proc::Tracer::enable(const std::string& filepath) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->filepath = filepath;
+    }
+
+    this->enabled.store(true);
+}
+
+void image_proc::Tracer::record(const char* name, const Clock::time_point& start, const Clock::time_point& end) {
+    thread_local const uint32_t thread_id = this->next_thread_id++;
+
+    const int64_t start_ns    = std::chrono::duration_cast<std::chrono::nanoseconds>(start - this->epoch).count(),
+                  duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    if (this->events.size() < TRACE_MAX_EVENTS) {
+        this->events.push_back({name, thread_id, start_ns, duration_ns});
+    } else {
+        this->nr_dropped_events++;
+    }
+
+    Samples& samples = this->samples[name];
+    samples.durations_ms[samples.count % TRACE_WINDOW] = duration_ns * 1e-6f;
+    samples.count++;
+}
+
+std::vector<image_proc::Tracer::StageSummary> image_proc::Tracer::getSummary() const {
+    std::vector<StageSummary> summaries;
+    std::vector<float> durations;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    for (const auto& [name, samples]: this->samples) {
+        durations.assign(samples.durations_ms.begin(), samples.durations_ms.begin() + std::min(samples.count, TRACE_WINDOW));
+
+        const double p99_ms = getPercentile(durations, 0.99);
+        summaries.push_back({std::string(name), samples.count, getPercentile(durations, 0.5), p99_ms});
+    }
+
+    std::sort(summaries.begin(), summaries.end(), [](const StageSummary& a, const StageSummary& b) {return a.name < b.name;});
+
+    return summaries;
+}
+
+bool image_proc::Tracer::write() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    std::ofstream file(this->filepath);
+    if (!file) {
+        std::cerr << "Unable to open trace file " << this->filepath << std::endl;
+
+        return false;
+    }
+
+    // complete events ("X") with microsecond timestamps, one pid for the whole program
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    file << std::fixed << std::setprecision(3);
+    for (size_t i = 0ul; i < this->events.size(); i++) {
+        const Event& event = this->events[i];
+
+        file << (i ? ",\n" : "\n")
+             << "{\"name\": \"" << event.name << "\", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread_id
+             << ", \"ts\": " << event.start_ns * 1e-3 << ", \"dur\": " << event.duration_ns * 1e-3 << '}';
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        std::cerr << "Unable to write trace file " << this->filepath << std::endl;
+
+        return false;
+    }
+
+    std::clog << "Wrote " << this->events.size() << " trace events to " << this->filepath;
+    if (this->nr_dropped_events) {
+        std::clog << " (" << this->nr_dropped_events << " later events dropped)";
+    }
+    std::clog << std::endl;
+
+    return true;
+}
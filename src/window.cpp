@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "window.hpp"
 
@@ -10,6 +16,31 @@
 #define SPACING         5
 #define SCALE_PADDING   5
 
+// milliseconds without slider input after which the full resolution gets rendered
+#define PREVIEW_IDLE_DELAY  250
+
+// zoom steps of the zoom buttons and Ctrl+scrolling, and the zoom range
+#define ZOOM_STEP   1.25
+#define ZOOM_MIN    (1.0 / 64.0)
+#define ZOOM_MAX    32.0
+
+// milliseconds without size allocations after which the limit previews follow a resize, and the number of cached previews
+#define LIMIT_PREVIEW_RESIZE_DELAY  100
+#define LIMIT_PREVIEW_CACHE_SIZE    64
+
+// milliseconds between refreshes of the stage timing overlay
+#define TRACE_OVERLAY_INTERVAL 1000
+
+// PNG strategies offered in the save dialog
+const std::array<const std::pair<const char*, int>, 6> png_strategies {{
+    {"Encoder default", image_proc::EncoderSettings::UNSET},
+    {"Default",         cv::IMWRITE_PNG_STRATEGY_DEFAULT},
+    {"Filtered",        cv::IMWRITE_PNG_STRATEGY_FILTERED},
+    {"Huffman only",    cv::IMWRITE_PNG_STRATEGY_HUFFMAN_ONLY},
+    {"RLE",             cv::IMWRITE_PNG_STRATEGY_RLE},
+    {"Fixed",           cv::IMWRITE_PNG_STRATEGY_FIXED},
+}};
+
 
 Window::Window() {
     this->set_title("Image Manipulator");
@@ -65,7 +96,6 @@ Window::Window() {
     color_space_selector_box->pack_end(this->limit_color_space_selector, Gtk::PACK_EXPAND_WIDGET);
     /* #endregion               color space selection */
 
-    this->getPreviews();
     for (size_t i = 0; i < NR_CHANNELS; i++) {
         this->limit_channel_frames[i] = Gtk::Frame(image_proc::color_space_channels[this->current_limit_color_space][i]);
         limit_adjustments->pack_start(this->limit_channel_frames[i], Gtk::PACK_EXPAND_WIDGET);
@@ -80,6 +110,7 @@ Window::Window() {
         this->limit_adjustments[adjustments_idx]->signal_value_changed().connect(sigc::bind(sigc::mem_fun2(*this, &Window::changedAdjustment), i, true));
         this->limit_min_scales[i] = Gtk::Scale(this->limit_adjustments[adjustments_idx], Gtk::ORIENTATION_VERTICAL);
         this->limit_min_scales[i].set_inverted();
+        this->limit_min_scales[i].signal_button_release_event().connect(sigc::mem_fun1(*this, &Window::scaleReleased), false);
         adjustments_box->pack_start(this->limit_min_scales[i], Gtk::PACK_EXPAND_PADDING, SCALE_PADDING);
 
         // preview
@@ -88,7 +119,8 @@ Window::Window() {
         limit_preview_scaling->signal_size_allocate().connect(sigc::bind(sigc::mem_fun2(*this, &Window::limitPreviewChangedSize), i));
         adjustments_box->pack_start(*limit_preview_scaling, Gtk::PACK_SHRINK);
         
-        image_proc::convertCVtoGTK(this->limit_preview_references[this->current_limit_color_space][i], this->limit_preview_images[i]);
+        this->limit_preview_shown[i] = this->getLimitPreview(this->current_limit_color_space, i, STD_PREVIEW_HEIGHT);
+        image_proc::convertCVtoGTK(this->limit_preview_shown[i], this->limit_preview_images[i]);
         limit_preview_scaling->add(this->limit_preview_images[i]);
 
         // max
@@ -97,6 +129,7 @@ Window::Window() {
         this->limit_adjustments[adjustments_idx]->signal_value_changed().connect(sigc::bind(sigc::mem_fun2(*this, &Window::changedAdjustment), i, false));
         Gtk::Scale* max_scale = Gtk::make_managed<Gtk::Scale>(this->limit_adjustments[adjustments_idx], Gtk::ORIENTATION_VERTICAL);
         max_scale->set_inverted();
+        max_scale->signal_button_release_event().connect(sigc::mem_fun1(*this, &Window::scaleReleased), false);
         adjustments_box->pack_start(*max_scale, Gtk::PACK_EXPAND_PADDING, SCALE_PADDING);
     }
 
@@ -242,6 +275,7 @@ Window::Window() {
     compression_level->add_mark(4.0, Gtk::POS_RIGHT, "4.0");
     compression_level->add_mark(8.0, Gtk::POS_RIGHT, "8.0 (default)");
     compression_level->set_size_request(-1, 200);
+    compression_level->signal_button_release_event().connect(sigc::mem_fun1(*this, &Window::scaleReleased), false);
     compression_modes_horizontal_align->pack_start(*compression_level, Gtk::PACK_EXPAND_PADDING);
     /* #endregion       compression  */
     /* #endregion   config side (left)*/
@@ -270,8 +304,31 @@ Window::Window() {
 
     // print
     //TODO: print, icon?
+
+    // zoom
+    const std::array<const std::pair<const char*, const char*>, 4> zoom_buttons {{
+        {"zoom-out", "Zoom out"}, {"zoom-original", "Zoom 1:1"}, {"zoom-fit-best", "Zoom to fit"}, {"zoom-in", "Zoom in (Ctrl+scroll over the images)"},
+    }};
+    for (const std::pair<const char*, const char*>& zoom_button: zoom_buttons) {
+        Gtk::Button* button = Gtk::make_managed<Gtk::Button>();
+        button->set_image_from_icon_name(zoom_button.first, Gtk::ICON_SIZE_BUTTON);
+        button->set_tooltip_text(zoom_button.second);
+        utility_bar->pack_start(*button, Gtk::PACK_SHRINK);
+
+        const std::string icon_name = zoom_button.first;
+        if (icon_name == "zoom-fit-best") {
+            button->signal_clicked().connect(sigc::mem_fun0(*this, &Window::zoomToFit));
+        } else {
+            button->signal_clicked().connect([this, icon_name]() {
+                const double zoom = this->altered_image_widget.getZoom();
+
+                this->setZoom(icon_name == "zoom-in" ? zoom * ZOOM_STEP : icon_name == "zoom-out" ? zoom / ZOOM_STEP : 1.0);
+            });
+        }
+    }
     /* #endregion           buttons */
 
+    utility_bar->pack_start(this->activity_spinner, Gtk::PACK_SHRINK);
     utility_bar->pack_start(this->average_label, Gtk::PACK_EXPAND_PADDING);
 
     /* #region              horizontal vertical switch */
@@ -295,19 +352,40 @@ Window::Window() {
     /* #endregion       utility bar */
 
     /* #region          images */
-    Gtk::ScrolledWindow* image_scroll_window = Gtk::make_managed<Gtk::ScrolledWindow>();
-    image_scroll_window->set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
-    right_base->pack_end(*image_scroll_window, Gtk::PACK_EXPAND_WIDGET);
+    this->image_scroll_window.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+    this->image_scroll_window.add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK);
+    this->image_scroll_window.signal_scroll_event().connect(sigc::mem_fun1(*this, &Window::imageScrolled), false);
+    this->image_scroll_window.get_hadjustment()->signal_value_changed().connect(sigc::mem_fun0(*this, &Window::imageViewportChanged));
+    this->image_scroll_window.get_vadjustment()->signal_value_changed().connect(sigc::mem_fun0(*this, &Window::imageViewportChanged));
+    this->image_overlay.add(this->image_scroll_window);
+    right_base->pack_end(this->image_overlay, Gtk::PACK_EXPAND_WIDGET);
+
+    // only while tracing, the timings are of no interest otherwise
+    if (image_proc::Tracer::get().isEnabled()) {
+        this->trace_label.set_halign(Gtk::ALIGN_END);
+        this->trace_label.set_valign(Gtk::ALIGN_START);
+        this->trace_label.set_margin_top(SPACING);
+        this->trace_label.set_margin_end(SPACING);
+        this->trace_label.get_style_context()->add_class("osd");
+        this->image_overlay.add_overlay(this->trace_label);
+
+        Glib::signal_timeout().connect(sigc::mem_fun0(*this, &Window::updateTraceOverlay), TRACE_OVERLAY_INTERVAL);
+    }
 
     this->images_box.set_border_width(5);
-    image_scroll_window->add(this->images_box);
+    this->image_scroll_window.add(this->images_box);
 
     this->images_box.pack_start(this->original_image_widget, Gtk::PACK_EXPAND_PADDING);
     this->images_box.pack_end(this->altered_image_widget, Gtk::PACK_EXPAND_PADDING);
     /* #endregion       images */
     /* #endregion   image side (right) */
 
+    this->render_worker.signalFrameReady().connect(sigc::mem_fun0(*this, &Window::renderFinished));
+    this->image_loader.signalResultReady().connect(sigc::mem_fun0(*this, &Window::imageLoaded));
+    this->image_saver.signalSaveFinished().connect(sigc::mem_fun0(*this, &Window::saveFinished));
+
     Glib::signal_idle().connect_once(sigc::mem_fun0(*this, &Window::windowFinishSetup));
+    Glib::signal_idle().connect_once(sigc::mem_fun0(*this, &Window::generatePreviews), Glib::PRIORITY_LOW);
 
     // show
     this->maximize();
@@ -324,10 +402,12 @@ void Window::compressionModechange() {
             return;
         }
 
-        this->applyLimitEdits();
+        this->applyLimitEdits(true);
     } else {
-        this->applyChannelEdits();
+        this->applyChannelEdits(true);
     }
+
+    this->scheduleFullRender();
 }
 
 void Window::limitColorSpaceChanged() {
@@ -343,13 +423,12 @@ void Window::limitColorSpaceChanged() {
         this->current_limit_color_space = new_color_space;
     }
 
-    this->getPreviews();
+    // convert in the background while the previews get updated
+    this->conversion_cache.prefetch(new_color_space);
+    this->proxy_conversion_cache.prefetch(new_color_space);
 
-    Gdk::Rectangle rect;
+    this->updateLimitPreviews();
     for (size_t i = 0ul; i < NR_CHANNELS; i++) {
-        image_proc::convertCVtoGTK(this->limit_preview_references[new_color_space][i], this->limit_preview_images[i]);
-        this->limitPreviewChangedSize(rect, i);
-
         this->limit_channel_frames[i].set_label(image_proc::color_space_channels[new_color_space][i]);
     }
 
@@ -399,6 +478,90 @@ void Window::directActivationBlockingChanged(const Gtk::StateFlags&) {
         this->applyLimitEdits();
     }
 }
+
+void Window::setZoom(double zoom, double anchor_x, double anchor_y) {
+    zoom = std::clamp(zoom, ZOOM_MIN, ZOOM_MAX);
+
+    const double old_zoom = this->altered_image_widget.getZoom();
+    if (zoom == old_zoom) {
+        return;
+    }
+
+    const Gtk::Allocation allocation = this->image_scroll_window.get_allocation();
+    if (anchor_x < 0.0 || anchor_y < 0.0) {
+        anchor_x = allocation.get_width()  / 2.0;
+        anchor_y = allocation.get_height() / 2.0;
+    }
+
+    this->original_image_widget.setZoom(zoom);
+    this->altered_image_widget.setZoom(zoom);
+
+    // keep the anchor over the same image position, once the new size got allocated
+    const Glib::RefPtr<Gtk::Adjustment> horizontal = this->image_scroll_window.get_hadjustment(),
+                                        vertical   = this->image_scroll_window.get_vadjustment();
+    const double ratio = zoom / old_zoom;
+    const double x = (horizontal->get_value() + anchor_x) * ratio - anchor_x,
+                 y = (vertical->get_value()   + anchor_y) * ratio - anchor_y;
+
+    Glib::signal_idle().connect_once([horizontal, vertical, x, y]() {
+        horizontal->set_value(x);
+        vertical->set_value(y);
+    });
+}
+
+void Window::zoomToFit() {
+    if (this->original_image.empty()) {
+        return;
+    }
+
+    const cv::Size visible_size = this->getVisibleImageSize();
+    if (visible_size.area() <= 0) {
+        return;
+    }
+
+    this->setZoom(std::min(static_cast<double>(visible_size.width)  / this->original_image.cols,
+                           static_cast<double>(visible_size.height) / this->original_image.rows));
+}
+
+bool Window::imageScrolled(GdkEventScroll* event) {
+    if (!(event->state & GDK_CONTROL_MASK)) {
+        return false;
+    }
+
+    double steps = 0.0;
+    switch (event->direction) {
+        case GDK_SCROLL_UP:
+            steps = 1.0;
+            break;
+        case GDK_SCROLL_DOWN:
+            steps = -1.0;
+            break;
+        case GDK_SCROLL_SMOOTH:
+            steps = -event->delta_y;
+            break;
+        default:
+            return false;
+    }
+
+    // the event coordinates may be relative to the scrolled content
+    int x, y;
+    this->image_scroll_window.get_pointer(x, y);
+    this->setZoom(this->altered_image_widget.getZoom() * std::pow(ZOOM_STEP, steps), x, y);
+
+    return true;
+}
+
+void Window::imageViewportChanged() {
+    if (!this->tiled_generation) {
+        return;
+    }
+
+    // tiles rendered so far are cached, only the newly visible ones get rendered
+    const cv::Rect viewport = this->getViewport();
+    if (viewport.area() > 0) {
+        this->tiled_generation = this->render_worker.request(this->original_image, this->requested_parameters, cv::Size(), viewport);
+    }
+}
 /* #endregion       button signals */
 
 /* #region          other */
@@ -433,76 +596,265 @@ void Window::changedAdjustment(size_t channel_idx, bool called_from_min) {
             }
         }
 
-        this->applyLimitEdits();
+        this->applyLimitEdits(true);
+        this->scheduleFullRender();
 
         // switch blocking for this channel off
         this->channel_blocked_flags ^= blocked_mask;
     }
 }
 
-void Window::limitPreviewChangedSize(Gtk::Allocation&, const size_t& channel_idx) {
-    const Gdk::Rectangle scale_rect = this->limit_min_scales[channel_idx].get_range_rect();
+void Window::scheduleFullRender() {
+    this->full_render_timeout.disconnect();
+    this->full_render_timeout = Glib::signal_timeout().connect(sigc::mem_fun0(*this, &Window::finishInteractiveEdit), PREVIEW_IDLE_DELAY);
+}
 
-    const int scale_height = scale_rect.get_height(),
-              scale_y      = scale_rect.get_y();
-    
-    int limit_preview_width  = STD_PREVIEW_WIDTH, // scale_height * this->limit_preview_aspect_ratio,
-        limit_preview_height = scale_height;
+bool Window::finishInteractiveEdit() {
+    this->full_render_timeout.disconnect();
 
-    Glib::RefPtr<Gdk::Pixbuf> buffer = this->limit_preview_images[channel_idx].get_pixbuf();
-    if (!buffer) {
-        std::clog << "Image for color space: " << image_proc::color_space_names[this->current_limit_color_space]
-                  << " channel "               << channel_idx + 1
-                  << " not yet set. Skipping." << std::endl;
+    if (this->current_page_number == Pages::LIMIT) {
+        this->applyLimitEdits();
+    } else {
+        this->applyChannelEdits();
+    }
 
-        return;
+    // one shot timeout
+    return false;
+}
+
+bool Window::scaleReleased(GdkEventButton*) {
+    // only if a drag left a preview behind
+    if (this->full_render_timeout.connected()) {
+        this->finishInteractiveEdit();
+    }
+
+    // let the scale handle the event as well
+    return false;
+}
+
+bool Window::updateTraceOverlay() {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(2)
+         << std::left << std::setw(30) << "stage" << std::right << std::setw(8) << "runs" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms";
+
+    for (const image_proc::Tracer::StageSummary& summary: image_proc::Tracer::get().getSummary()) {
+        text << '\n' << std::left << std::setw(30) << summary.name << std::right << std::setw(8) << summary.count
+             << std::setw(10) << summary.p50_ms << std::setw(10) << summary.p99_ms;
+    }
+
+    this->trace_label.set_markup("<tt>" + Glib::Markup::escape_text(text.str()) + "</tt>");
+
+    // periodic timeout
+    return true;
+}
+
+bool Window::on_draw(const Cairo::RefPtr<Cairo::Context>& context) {
+    TRACE_SCOPE("Window::draw");
+
+    return Gtk::Window::on_draw(context);
+}
+
+void Window::limitPreviewChangedSize(Gtk::Allocation&, const size_t&) {
+    // a window drag allocates continuously, only the last allocation counts
+    this->limit_preview_resize_timeout.disconnect();
+    this->limit_preview_resize_timeout = Glib::signal_timeout().connect(sigc::mem_fun0(*this, &Window::updateLimitPreviews), LIMIT_PREVIEW_RESIZE_DELAY);
+}
+
+bool Window::updateLimitPreviews() {
+    TRACE_SCOPE("Window::updateLimitPreviews");
+
+    this->limit_preview_resize_timeout.disconnect();
+
+    for (size_t channel_idx = 0ul; channel_idx < NR_CHANNELS; channel_idx++) {
+        // the pixbuf shares the pixels of the preview, an unchanged one is not set again
+        const cv::Mat& preview = this->getLimitPreview(this->current_limit_color_space, channel_idx, this->getLimitPreviewHeight(channel_idx));
+        if (preview.data != this->limit_preview_shown[channel_idx].data) {
+            image_proc::convertCVtoGTK(preview, this->limit_preview_images[channel_idx]);
+            this->limit_preview_shown[channel_idx] = preview;
+        }
+
+        this->limit_preview_images[channel_idx].set_margin_top(this->limit_min_scales[channel_idx].get_range_rect().get_y() / 2);
     }
 
-    buffer = buffer->scale_simple(limit_preview_width, limit_preview_height, Gdk::INTERP_BILINEAR);
-    this->limit_preview_images[channel_idx].set(buffer);
+    // the other color spaces at the new height, once the main loop is idle again
+    Glib::signal_idle().connect_once(sigc::mem_fun0(*this, &Window::generatePreviews), Glib::PRIORITY_LOW);
+
+    // one shot timeout
+    return false;
+}
+
+int Window::getLimitPreviewHeight(size_t channel_idx) {
+    // scales that are not allocated yet get the standard height
+    const int scale_height = this->limit_min_scales[channel_idx].get_range_rect().get_height();
 
-    this->limit_preview_images[channel_idx].set_margin_top(scale_y / 2);
+    return scale_height > 0 ? scale_height : STD_PREVIEW_HEIGHT;
 }
 /* #endregion       other */
 /* #endregion   signal handlers*/
 
 /* #region      apply functions */
-void Window::applyLimitEdits() {
+void Window::applyLimitEdits(bool preview) {
+    TRACE_SCOPE("Window::applyLimitEdits");
+
     if (this->original_image.empty() || this->direct_activation_blocked) {
         return;
     }
 
-    cv::Mat temp;
-    image_proc::limitImageByChannels(this->original_image, temp, this->current_limit_color_space,
-                                     this->limit_adjustments[0]->get_value(), this->limit_adjustments[1]->get_value(),
-                                     this->limit_adjustments[2]->get_value(), this->limit_adjustments[3]->get_value(),
-                                     this->limit_adjustments[4]->get_value(), this->limit_adjustments[5]->get_value());
-    image_proc::compressImage(temp, this->altered_image, this->current_compression_level);
-
-    this->average_label.set_text(image_proc::getAverageColorString(this->altered_image));
-    
-    image_proc::convertCVtoGTK(this->altered_image, this->altered_image_widget);
+    this->requestRender(this->getEditParameters(image_proc::EditMode::LIMIT), preview);
 }
 
-void Window::applyChannelEdits() {
+void Window::applyChannelEdits(bool preview) {
+    TRACE_SCOPE("Window::applyChannelEdits");
+
     if (this->original_image.empty()) {
         return;
     }
 
-    cv::Mat temp;
-    image_proc::manipulateChannels(this->original_image, temp, this->current_channel_modifier, this->current_channel_option);
-    image_proc::compressImage(temp, this->altered_image, this->current_compression_level);
+    this->requestRender(this->getEditParameters(image_proc::EditMode::CHANNELS), preview);
+}
+
+cv::Size Window::getVisibleImageSize() {
+    // the altered image gets about half of the visible image area
+    const Gtk::Allocation allocation = this->image_scroll_window.get_allocation();
+    cv::Size visible_size(allocation.get_width(), allocation.get_height());
+    if (this->images_box.get_orientation() == Gtk::ORIENTATION_HORIZONTAL) {
+        visible_size.width /= 2;
+    } else {
+        visible_size.height /= 2;
+    }
+
+    return visible_size;
+}
 
-    this->average_label.set_text(image_proc::getAverageColorString(this->altered_image));
+cv::Size Window::getPreviewSize() {
+    const cv::Size visible_size = this->getVisibleImageSize();
 
-    image_proc::convertCVtoGTK(this->altered_image, this->altered_image_widget);
+    // zoomed out further than the visible area, the image is shown even smaller
+    const double scale = std::min({static_cast<double>(visible_size.width)  / this->original_image.cols,
+                                   static_cast<double>(visible_size.height) / this->original_image.rows,
+                                   this->altered_image_widget.getZoom()});
+    if (scale >= 1.0 || visible_size.area() <= 0) {
+        return cv::Size();
+    }
+
+    return cv::Size(std::max(1, cvRound(this->original_image.cols * scale)), std::max(1, cvRound(this->original_image.rows * scale)));
+}
+
+uint64_t Window::requestRender(const image_proc::EditParameters& parameters, bool preview) {
+    // an image small enough to be its own proxy needs no preview, the worker downscales the others
+    const cv::Size preview_size = preview ? this->getPreviewSize() : cv::Size();
+    const cv::Rect viewport = preview ? cv::Rect() : this->getViewport();
+
+    const uint64_t generation = this->render_worker.request(this->original_image, parameters, preview_size, viewport);
+
+    // any other request supersedes a tiled render, it must not be requested again
+    this->tiled_generation = viewport.area() > 0 ? generation : 0u;
+    this->requested_parameters = parameters;
+
+    return generation;
+}
+
+cv::Rect Window::getViewport() {
+    if (this->original_image.total() < TILED_RENDER_MIN_PIXELS) {
+        return cv::Rect();
+    }
+
+    // the visible part of the scrolled content, relative to the altered image and unzoomed
+    const Gtk::Allocation allocation = this->altered_image_widget.get_allocation();
+    const Glib::RefPtr<Gtk::Adjustment> horizontal = this->image_scroll_window.get_hadjustment(),
+                                        vertical   = this->image_scroll_window.get_vadjustment();
+    const double zoom = this->altered_image_widget.getZoom();
+
+    const int left   = cvFloor((horizontal->get_value() - allocation.get_x()) / zoom),
+              top    = cvFloor((vertical->get_value()   - allocation.get_y()) / zoom),
+              right  = cvCeil((horizontal->get_value() + horizontal->get_page_size() - allocation.get_x()) / zoom),
+              bottom = cvCeil((vertical->get_value()   + vertical->get_page_size()   - allocation.get_y()) / zoom);
+
+    const cv::Rect image_rect(cv::Point(), this->original_image.size());
+    const cv::Rect viewport = cv::Rect(cv::Point(left, top), cv::Point(right, bottom)) & image_rect;
+
+    // nothing to gain when the whole image is visible anyway
+    return viewport == image_rect ? cv::Rect() : viewport;
+}
+
+image_proc::EditParameters Window::getEditParameters(const image_proc::EditMode& mode) const {
+    image_proc::EditParameters parameters;
+    parameters.mode = mode;
+
+    parameters.color_space = this->current_limit_color_space;
+    for (size_t i = 0ul; i < 2ul * NR_CHANNELS; i++) {
+        parameters.limits[i] = this->limit_adjustments[i]->get_value();
+    }
+
+    parameters.modifier = this->current_channel_modifier;
+    parameters.channel  = this->current_channel_option;
+
+    parameters.compression_level = this->current_compression_level;
+
+    return parameters;
+}
+
+void Window::renderFinished() {
+    TRACE_SCOPE("Window::renderFinished");
+
+    std::unique_ptr<RenderWorker::Frame> frame = this->render_worker.takeFrame();
+
+    // several emissions can be answered by one take
+    if (!frame) {
+        return;
+    }
+
+    // the visible tiles of a large render, the complete frame follows
+    if (frame->region.area() > 0) {
+        if (this->altered_image_widget.setRegion(frame->image, frame->region)) {
+            this->preview_image.release();
+        }
+        return;
+    }
+
+    // the complete frame of the edit to be saved (or a newer one), whatever is shown right now
+    if (!frame->preview && !this->pending_save_filepath.empty() && frame->generation >= this->pending_save_generation) {
+        this->image_saver.save(frame->image, this->pending_save_filepath, this->encoder_settings);
+        this->pending_save_filepath.clear();
+        this->updateActivity();
+    }
+
+    // fully cached renders (e.g. switching back to an unchanged tab) may hand out the frame already shown
+    const cv::Mat& displayed = this->preview_image.empty() ? this->altered_image : this->preview_image;
+    if (frame->image.data == displayed.data && frame->preview == !this->preview_image.empty()) {
+        return;
+    }
+
+    if (frame->preview) {
+        // drawn at the size of the full resolution image, so the layout does not jump while dragging
+        this->altered_image_widget.setImage(frame->image, this->original_image.size());
+        this->preview_image = std::move(frame->image);
+    } else {
+        this->altered_image_widget.setImage(frame->image);
+        if (frame->generation >= this->tiled_generation) {
+            this->tiled_generation = 0u;
+        }
+        this->average_label.set_text(image_proc::getAverageColorString(frame->statistics));
+
+        // the first frame of a new image lets go of the last buffers of the old size
+        const bool resized = this->altered_image.size() != frame->image.size();
+        this->altered_image = std::move(frame->image);
+        this->preview_image.release();
+        if (resized) {
+            this->scratch_arena.trim();
+        }
+    }
 }
 /* #endregion   apply functions*/
 
 /* #region      image load/save */
 void Window::saveImage() {
-    // sanity check
-    assert(!this->original_image.empty());
+    // the button is always enabled, but there is nothing to save before the first full frame arrived
+    if (this->altered_image.empty()) {
+        this->average_label.set_text("Nothing to save yet");
+
+        return;
+    }
 
     Gtk::FileChooserDialog dialog(*this, "Save", Gtk::FILE_CHOOSER_ACTION_SAVE, Gtk::DIALOG_DESTROY_WITH_PARENT & Gtk::DIALOG_MODAL);
     dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
@@ -524,6 +876,42 @@ void Window::saveImage() {
     extra->add_pattern("*.*");
     dialog.add_filter(extra);
 
+    // encoder settings: fast saves for intermediate output, small files for final delivery
+    Gtk::Grid* encoder_grid = Gtk::make_managed<Gtk::Grid>();
+    encoder_grid->set_row_spacing(SPACING);
+    encoder_grid->set_column_spacing(SPACING);
+
+    // UNSET (-1) leaves the level to the encoder, which then tunes for speed
+    Gtk::SpinButton* png_compression = Gtk::make_managed<Gtk::SpinButton>(Gtk::Adjustment::create(this->encoder_settings.png_compression, -1.0, 9.0, 1.0));
+    png_compression->set_tooltip_text("-1: encoder default, 0: fastest, 9: smallest");
+    encoder_grid->attach(*Gtk::make_managed<Gtk::Label>("PNG compression"), 0, 0);
+    encoder_grid->attach(*png_compression, 1, 0);
+
+    Gtk::ComboBoxText* png_strategy = Gtk::make_managed<Gtk::ComboBoxText>();
+    for (const std::pair<const char*, int>& strategy: png_strategies) {
+        png_strategy->append(strategy.first);
+    }
+    png_strategy->set_active(0);
+    for (size_t i = 0ul; i < png_strategies.size(); i++) {
+        if (png_strategies[i].second == this->encoder_settings.png_strategy) {
+            png_strategy->set_active(i);
+        }
+    }
+    encoder_grid->attach(*Gtk::make_managed<Gtk::Label>("PNG strategy"), 2, 0);
+    encoder_grid->attach(*png_strategy, 3, 0);
+
+    Gtk::SpinButton* jpeg_quality = Gtk::make_managed<Gtk::SpinButton>(Gtk::Adjustment::create(this->encoder_settings.jpeg_quality, -1.0, 100.0, 1.0));
+    jpeg_quality->set_tooltip_text("-1: encoder default (95)");
+    encoder_grid->attach(*Gtk::make_managed<Gtk::Label>("JPEG quality"), 0, 1);
+    encoder_grid->attach(*jpeg_quality, 1, 1);
+
+    Gtk::CheckButton* jpeg_optimize = Gtk::make_managed<Gtk::CheckButton>("Optimize JPEG");
+    jpeg_optimize->set_active(this->encoder_settings.jpeg_optimize);
+    encoder_grid->attach(*jpeg_optimize, 2, 1, 2, 1);
+
+    encoder_grid->show_all();
+    dialog.set_extra_widget(*encoder_grid);
+
     std::string filepath;
     int response = dialog.run();
     switch (response) {
@@ -539,9 +927,44 @@ void Window::saveImage() {
             exit(1);
     }
 
-    if (!image_proc::saveImage(this->altered_image, filepath)) {
-        Gtk::MessageDialog dialog(*this, "Failed to save image.", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
-        dialog.run();
+    TRACE_SCOPE("Window::saveImage");
+
+    this->encoder_settings.png_compression = png_compression->get_value_as_int();
+    this->encoder_settings.png_strategy    = png_strategies[png_strategy->get_active_row_number()].second;
+    this->encoder_settings.jpeg_quality    = jpeg_quality->get_value_as_int();
+    this->encoder_settings.jpeg_optimize   = jpeg_optimize->get_active();
+
+    // altered_image may be older than the edit the sliders and the view show (drags, tiled renders),
+    // so the latest edit gets rendered completely and saved once that frame arrived
+    this->full_render_timeout.disconnect();
+    this->pending_save_filepath   = filepath;
+    this->pending_save_generation = this->requestRender(this->requested_parameters, false);
+    this->average_label.set_text("Saving " + std::filesystem::path(filepath).filename().string() + " ...");
+    this->updateActivity();
+}
+
+void Window::saveFinished() {
+    TRACE_SCOPE("Window::saveFinished");
+
+    for (const ImageSaver::Result& result: this->image_saver.takeResults()) {
+        if (result.success) {
+            std::clog << "Saved " << result.filepath << " in " << result.seconds << 's' << std::endl;
+            this->average_label.set_text("Saved " + std::filesystem::path(result.filepath).filename().string());
+        } else {
+            Gtk::MessageDialog dialog(*this, "Failed to save image:", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+            dialog.set_secondary_text(result.filepath);
+            dialog.run();
+        }
+    }
+
+    this->updateActivity();
+}
+
+void Window::updateActivity() {
+    if (this->loading || !this->pending_save_filepath.empty() || this->image_saver.getPendingCount()) {
+        this->activity_spinner.start();
+    } else {
+        this->activity_spinner.stop();
     }
 }
 
@@ -550,23 +973,68 @@ void Window::loadImage(const std::string& filepath) {
         return;
     }
 
-    // load initial image
-    if (!image_proc::loadImage(this->original_image, filepath)) {
-        Gtk::MessageDialog dialog(*this, "Failed to load initial image:", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
-        dialog.set_secondary_text(filepath);
-        dialog.run();
-    } else {
-        image_proc::convertCVtoGTK(this->original_image, this->original_image_widget);
+    this->image_loader.load(filepath);
+    this->loading = true;
+    this->average_label.set_text("Loading " + std::filesystem::path(filepath).filename().string() + " ...");
+    this->updateActivity();
+}
 
-        if (this->current_page_number == Pages::LIMIT) {
-            if (this->direct_activation_blocked) {
-                return;
+void Window::imageLoaded() {
+    std::unique_ptr<ImageLoader::Result> result = this->image_loader.takeResult();
+
+    // several emissions can be answered by one take, results of cancelled loads are dropped
+    if (!result) {
+        return;
+    }
+
+    const std::string filename = std::filesystem::path(result->filepath).filename().string();
+    switch (result->stage) {
+        case ImageLoader::Stage::PREVIEW:
+            this->original_image_widget.setImage(result->image);
+            this->loading_image = std::move(result->image);
+            this->average_label.set_text("Loading " + filename + " (preview shown) ...");
+
+            return;
+        case ImageLoader::Stage::FAILED: {
+            // back to the image that is still being edited
+            if (!this->original_image.empty()) {
+                this->original_image_widget.setImage(this->original_image);
             }
+            this->loading_image.release();
+            this->loading = false;
+            this->average_label.set_text("");
+            this->updateActivity();
 
-            this->applyLimitEdits();
-        } else {
-            this->applyChannelEdits();
+            Gtk::MessageDialog dialog(*this, "Failed to load image:", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
+            dialog.set_secondary_text(result->filepath);
+            dialog.run();
+
+            return;
         }
+        case ImageLoader::Stage::FULL:
+            break;
+    }
+
+    TRACE_SCOPE("Window::imageLoaded");
+
+    // a new image, the render worker might still be reading the old one
+    this->original_image = std::move(result->image);
+    this->conversion_cache.setSource(this->original_image);
+    this->conversion_cache.prefetch(this->current_limit_color_space);
+    this->original_image_widget.setImage(this->original_image);
+    this->loading_image.release();
+    this->loading = false;
+    this->average_label.set_text("");
+    this->updateActivity();
+
+    if (this->current_page_number == Pages::LIMIT) {
+        if (this->direct_activation_blocked) {
+            return;
+        }
+
+        this->applyLimitEdits();
+    } else {
+        this->applyChannelEdits();
     }
 }
 
@@ -606,48 +1074,65 @@ void Window::loadImage() {
             exit(1);
     }
 
-    if (!image_proc::loadImage(this->original_image, filepath)) {
-        Gtk::MessageDialog dialog(*this, "Failed to load image:", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
-        dialog.set_secondary_text(filepath);
-        dialog.run();
-    } else {
-        image_proc::convertCVtoGTK(this->original_image, this->original_image_widget);
+    this->loadImage(filepath);
+}
 
-        if (this->current_page_number == Pages::LIMIT) {
-            if (this->direct_activation_blocked) {
-                return;
-            }
+const cv::Mat& Window::getLimitPreview(const image_proc::ColorSpace& color_space, size_t channel_idx, int height) {
+    const std::tuple<image_proc::ColorSpace, size_t, int> key(color_space, channel_idx, height);
 
-            this->applyLimitEdits();
-        } else {
-            this->applyChannelEdits();
-        }
+    const auto found = this->limit_preview_cache.find(key);
+    if (found != this->limit_preview_cache.end()) {
+        return found->second;
     }
+
+    this->trimLimitPreviewCache(height);
+
+    // generated from scratch at the exact height, rescaling would blur the gradient
+    cv::Mat& preview = this->limit_preview_cache[key];
+    preview = image_proc::createLimitPreview(color_space, channel_idx, height);
+
+    return preview;
 }
 
-void Window::getPreviews() {
-    if (!this->limit_preview_references[this->current_limit_color_space][0].empty()) {
+void Window::trimLimitPreviewCache(int height) {
+    if (this->limit_preview_cache.size() < LIMIT_PREVIEW_CACHE_SIZE) {
         return;
     }
 
-    std::clog << "Loading previews for " << image_proc::color_space_names[this->current_limit_color_space] << std::endl;
+    // heights of earlier window sizes go first, shown previews stay alive through limit_preview_shown
+    for (auto it = this->limit_preview_cache.begin(); it != this->limit_preview_cache.end();) {
+        it = std::get<2>(it->first) != height ? this->limit_preview_cache.erase(it) : std::next(it);
+    }
+}
 
-    cv::Mat loaded_image;
-    std::string filepath;
+void Window::generatePreviews() {
+    TRACE_SCOPE("Window::generatePreviews");
 
-    for (size_t i = 0ul; i < NR_CHANNELS; i++) {
-        filepath = "../resources/" + image_proc::color_space_names[this->current_limit_color_space] + '_' + image_proc::color_space_channels[this->current_limit_color_space][i] + ".bmp";
-        loaded_image = cv::imread(filepath);
-        
-        if (loaded_image.empty()) {
-            Gtk::MessageDialog dialog(*this, "Failed to load preview image:", false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK, true);
-            dialog.set_secondary_text(filepath);
-            dialog.run();
+    // every color space at the current heights of the scales, unless already cached
+    std::vector<std::tuple<image_proc::ColorSpace, size_t, int>> missing;
+    for (size_t channel_idx = 0ul; channel_idx < NR_CHANNELS; channel_idx++) {
+        const int height = this->getLimitPreviewHeight(channel_idx);
+        this->trimLimitPreviewCache(height);
 
-            this->limit_preview_references[this->current_limit_color_space][i] = this->default_preview_image;
-        } else {
-            this->limit_preview_references[this->current_limit_color_space][i] = std::move(loaded_image);
+        for (size_t color_space = 0ul; color_space < image_proc::ColorSpace::LAST; color_space++) {
+            const std::tuple<image_proc::ColorSpace, size_t, int> key(static_cast<image_proc::ColorSpace>(color_space), channel_idx, height);
+
+            if (!this->limit_preview_cache.count(key)) {
+                missing.push_back(key);
+            }
+        }
+    }
+
+    // every (color space, channel) pair is independent, only the cache is filled afterwards
+    std::vector<cv::Mat> previews(missing.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(missing.size())), [&missing, &previews](const cv::Range& range) -> void {
+        for (int i = range.start; i < range.end; i++) {
+            previews[i] = image_proc::createLimitPreview(std::get<0>(missing[i]), std::get<1>(missing[i]), std::get<2>(missing[i]));
         }
+    });
+
+    for (size_t i = 0ul; i < missing.size(); i++) {
+        this->limit_preview_cache[missing[i]] = previews[i];
     }
 }
 /* #endregion   image load/save*/